@@ -0,0 +1,226 @@
+#!/usr/bin/env python3
+
+import argparse
+import json
+import socket
+import statistics
+import sys
+import threading
+import time
+
+from command_wrapper import CommandWrapper
+
+# End to end benchmark of a running bridge over Wi-Fi, optional, see README for setup
+# Regression gate is test/bench.cpp on the host, Wi-Fi timing is too noisy for it
+
+# Largest is 8KB each of TMS and TDI, exactly the 16KB getinfo: length
+XVC_SHIFT_BITS = (32, 256, 2048, 16384, 65536)
+# Compared against the baseline, max / stdev / loss are too noisy and only recorded
+GATED_SUFFIXES = ('_p50_ms', '_p95_ms', '_kbit_s', '_bytes_s')
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+def latency_metrics(prefix, samples):
+    return {
+        prefix + '_p50_ms': (percentile(samples, 0.50) * 1000, 'lower'),
+        prefix + '_p95_ms': (percentile(samples, 0.95) * 1000, 'lower'),
+        prefix + '_max_ms': (max(samples) * 1000, 'lower'),
+        prefix + '_stdev_ms': (statistics.pstdev(samples) * 1000, 'lower'),
+    }
+
+def recv_exact(conn, n):
+    buf = b''
+    while len(buf) < n:
+        data = conn.recv(n - len(buf))
+        if not data:
+            raise ConnectionError('Connection closed')
+        buf += data
+    return buf
+
+class XvcClient:
+
+    def __init__(self, ip, port):
+        self.conn = socket.create_connection((ip, port), 10)
+        self.conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        self.conn.sendall(b'getinfo:')
+        info = b''
+        while not info.endswith(b'\n'):
+            info += recv_exact(self.conn, 1)
+        self.max_bytes = int(info.split(b':')[1])
+        # Test-Logic-Reset then Run-Test/Idle, later vectors keep TMS low
+        self.shift(6, b'\x1f', b'\x00')
+        return
+
+    def shift(self, bits, tms, tdi):
+        n = (bits + 7) // 8
+        self.conn.sendall(b'shift:' + bits.to_bytes(4, 'little') + tms + tdi)
+        return recv_exact(self.conn, n)
+
+    def close(self):
+        self.conn.close()
+
+def bench_command(server, rounds):
+    samples = []
+    for i in range(0, rounds):
+        started = time.perf_counter()
+        server.send_command(1)
+        samples.append(time.perf_counter() - started)
+    return samples
+
+def bench_xvc(ip, port, rounds):
+    metrics = {}
+    xvc = XvcClient(ip, port)
+    for bits in XVC_SHIFT_BITS:
+        n = (bits + 7) // 8
+        # getinfo: length covers TMS and TDI together
+        if 2 * n > xvc.max_bytes:
+            continue
+        zeros = bytes(n)
+        started = time.perf_counter()
+        for i in range(0, rounds):
+            xvc.shift(bits, zeros, zeros)
+        elapsed = time.perf_counter() - started
+        metrics['xvc_shift_' + str(bits) + '_kbit_s'] = (bits * rounds / elapsed / 1000, 'higher')
+    xvc.close()
+    return metrics
+
+# Needs target console echoing back, or TX / RX looped on the target side
+def bench_serial(ip, port, rounds, bulk_bytes):
+    metrics = {}
+    conn = socket.create_connection((ip, port), 10)
+    conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    samples = []
+    for i in range(0, rounds):
+        started = time.perf_counter()
+        conn.sendall(b'U')
+        recv_exact(conn, 1)
+        samples.append(time.perf_counter() - started)
+    metrics.update(latency_metrics('serial_echo', samples))
+    payload = bytes((i % 94) + 33 for i in range(0, bulk_bytes))
+    received = [0]
+    def reader():
+        while received[0] < bulk_bytes:
+            data = conn.recv(4096)
+            if not data:
+                break
+            received[0] += len(data)
+    t = threading.Thread(target = reader)
+    started = time.perf_counter()
+    t.start()
+    conn.sendall(payload)
+    t.join(30)
+    elapsed = time.perf_counter() - started
+    # Bytes moved in both directions at once
+    metrics['serial_duplex_bytes_s'] = ((bulk_bytes + received[0]) / elapsed, 'higher')
+    metrics['serial_duplex_loss_bytes'] = (bulk_bytes - received[0], 'lower')
+    conn.close()
+    return metrics
+
+# Command latency while XVC / serial keep the main loop busy
+def bench_loaded(args, server):
+    stop = threading.Event()
+    def xvc_load():
+        xvc = XvcClient(args.ip, args.xvc_port)
+        n = min(xvc.max_bytes // 2, 2048)
+        zeros = bytes(n)
+        while not stop.is_set():
+            xvc.shift(n * 8, zeros, zeros)
+        xvc.close()
+    def serial_load():
+        conn = socket.create_connection((args.ip, args.serial_port), 10)
+        conn.settimeout(0.01)
+        while not stop.is_set():
+            conn.sendall(b'U' * 64)
+            try:
+                conn.recv(4096)
+            except socket.timeout:
+                pass
+        conn.close()
+    loads = [threading.Thread(target = xvc_load)]
+    if args.serial:
+        loads.append(threading.Thread(target = serial_load))
+    for t in loads:
+        t.start()
+    time.sleep(0.2)
+    try:
+        samples = bench_command(server, args.rounds)
+    finally:
+        stop.set()
+        for t in loads:
+            t.join()
+    return latency_metrics('command_loaded_rtt', samples)
+
+def compare(metrics, baseline, threshold):
+    regressions = []
+    for name, entry in baseline.items():
+        if name not in metrics:
+            regressions.append(name + ': missing from this run')
+            continue
+        if not name.endswith(GATED_SUFFIXES):
+            continue
+        value, better = metrics[name]['value'], entry['better']
+        base = entry['value']
+        if base == 0:
+            continue
+        change = (value - base) / base
+        if (better == 'higher' and change < -threshold) or (better == 'lower' and change > threshold):
+            regressions.append(name + ': ' + format(base, '.3f') + ' -> ' + format(value, '.3f') + ' (' + format(change * 100, '+.1f') + '%)')
+    return regressions
+
+def run(args):
+    metrics = {}
+    server = CommandWrapper()
+    server.connect(args.ip, args.port)
+    xvc_before = server.send_command(4)[2]
+    serial_before = server.send_command(6)[2]
+    try:
+        metrics.update(latency_metrics('command_rtt', bench_command(server, args.rounds)))
+        if args.xvc:
+            server.send_command(3, 1)
+            metrics.update(bench_xvc(args.ip, args.xvc_port, args.rounds))
+        if args.serial:
+            server.send_command(5, 1)
+            metrics.update(bench_serial(args.ip, args.serial_port, args.rounds, args.serial_bytes))
+        if args.xvc:
+            metrics.update(bench_loaded(args, server))
+    finally:
+        server.send_command(3, xvc_before)
+        server.send_command(5, serial_before)
+    return {name: {'value': value, 'better': better} for name, (value, better) in metrics.items()}
+
+def _main():
+    parser = argparse.ArgumentParser(description='Benchmark XVC, serial and command services of a bridge.')
+    parser.add_argument('-i', '--ip', help='Bridge address.', required=True)
+    parser.add_argument('-p', '--port', help='Command port.', default=42069, type=int)
+    parser.add_argument('--xvc-port', default=2542, type=int)
+    parser.add_argument('--serial-port', default=2222, type=int)
+    parser.add_argument('--no-xvc', dest='xvc', help='Skip XVC and loaded benchmarks.', action='store_false')
+    parser.add_argument('--serial', help='Run serial benchmarks, target must echo.', action='store_true')
+    parser.add_argument('--serial-bytes', help='Bulk transfer size.', default=65536, type=int)
+    parser.add_argument('-n', '--rounds', help='Samples per latency / throughput metric.', default=200, type=int)
+    parser.add_argument('-o', '--output', help='Write results as JSON.', default=None)
+    parser.add_argument('-b', '--baseline', help='Compare against results JSON, exit 1 on regression.', default=None)
+    parser.add_argument('--threshold', help='Allowed regression ratio.', default=0.10, type=float)
+    args = parser.parse_args()
+
+    metrics = run(args)
+    for name in sorted(metrics):
+        print(name.ljust(32) + format(metrics[name]['value'], '12.3f'))
+    if args.output:
+        with open(args.output, 'w') as f:
+            json.dump({'time': time.time(), 'ip': args.ip, 'metrics': metrics}, f, indent = 2, sort_keys = True)
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)['metrics']
+        regressions = compare(metrics, baseline, args.threshold)
+        if regressions:
+            print('REGRESSIONS over ' + format(args.threshold * 100, '.0f') + '%:')
+            for r in regressions:
+                print('\t' + r)
+            sys.exit(1)
+        print('No regression over ' + format(args.threshold * 100, '.0f') + '%.')
+
+if __name__ == '__main__':
+    _main()
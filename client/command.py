@@ -8,7 +8,7 @@ from consolemenu.items import *
 from consolemenu.format import *
 from consolemenu.prompt_utils import *
 
-from command_wrapper import CommandWrapper
+from command_wrapper import CommandWrapper, UdpCommandWrapper
 
 def handle_exception(menu, server, exception):
     menu.epilogue_text = 'Exception: ' + str(exception)
@@ -115,6 +115,88 @@ def get_serial_run(menu, server):
         menu.epilogue_text = 'Failure: Unknown value.'
     return
 
+def get_jtag_chain(menu, server):
+    print('Sending request...')
+    try:
+        count = server.send_command(9)[2]
+        devices = []
+        for i in range(0, count):
+            idcode = server.send_command(10, i)[2]
+            ir_len = server.send_command(11, i)[2]
+            devices.append('#' + str(i) + ' IDCODE: ' + format(idcode, '#010x') + ' IR: ' + (str(ir_len) if ir_len else '?'))
+    except Exception as err:
+        handle_exception(menu, server, err)
+        return
+    if count == 0:
+        menu.epilogue_text = 'No JTAG chain, is XVC server running?'
+    else:
+        menu.epilogue_text = 'JTAG chain (TDO first): ' + ', '.join(devices) + '.'
+    return
+
+def rediscover_jtag_chain(menu, server):
+    print('Sending request...')
+    try:
+        ret = server.send_command(17)
+    except Exception as err:
+        handle_exception(menu, server, err)
+        return
+    if ret[2]:
+        menu.epilogue_text = 'JTAG chain discovery scheduled, runs once no XVC client is connected.'
+    else:
+        menu.epilogue_text = 'XVC server is not running.'
+    return
+
+def framing_text(framing):
+    return str((framing & 3) + 5) + 'NOE'[(framing >> 2) & 3] + ['1', '1.5', '2'][min((framing >> 4) & 3, 2)]
+
+def set_serial_baud(menu, server):
+    for i, baud in enumerate(CommandWrapper.BAUD_TABLE):
+        print(str(i) + '. ' + str(baud))
+    i = input('Baud index (\"q\" to cancel): ')
+    if not i.isdigit() or int(i) >= len(CommandWrapper.BAUD_TABLE):
+        return
+    print('Sending request...')
+    try:
+        ret = server.send_command(12, int(i))
+    except Exception as err:
+        handle_exception(menu, server, err)
+        return
+    menu.epilogue_text = 'Serial baud: ' + str(ret[2]) + '.'
+    return
+
+def set_serial_framing(menu, server):
+    data_bits = input('Data bits 5-8 (\"q\" to cancel): ')
+    if data_bits not in ('5', '6', '7', '8'):
+        return
+    parity = input('Parity N/O/E (\"q\" to cancel): ').upper()
+    if parity not in ('N', 'O', 'E'):
+        return
+    stop_bits = input('Stop bits 1/1.5/2 (\"q\" to cancel): ')
+    if stop_bits not in ('1', '1.5', '2'):
+        return
+    framing = (int(data_bits) - 5) | ('NOE'.index(parity) << 2) | (['1', '1.5', '2'].index(stop_bits) << 4)
+    print('Sending request...')
+    try:
+        ret = server.send_command(14, framing)
+    except Exception as err:
+        handle_exception(menu, server, err)
+        return
+    menu.epilogue_text = 'Serial framing: ' + framing_text(ret[2]) + '.'
+    return
+
+def get_serial_settings(menu, server):
+    print('Sending request...')
+    try:
+        baud = server.send_command(13)[2]
+        framing = server.send_command(15)[2]
+        stats = [server.send_command(16, i)[2] for i in range(0, len(CommandWrapper.SERIAL_STATS))]
+    except Exception as err:
+        handle_exception(menu, server, err)
+        return
+    menu.epilogue_text = 'Serial ' + str(baud) + ' ' + framing_text(framing) + ', ' + \
+        ', '.join(name + ': ' + str(val) for name, val in zip(CommandWrapper.SERIAL_STATS, stats)) + '.'
+    return
+
 def reconfig_wifi(menu, server):
     screen = Screen()
     print('This will also reset the command server')
@@ -201,6 +283,15 @@ def functions():
     print('6. Get serial running state.')
     print('7. Reconfig wifi.')
     print('8. Reset server.')
+    print('9. Get JTAG chain device count.')
+    print('10. Get JTAG chain device IDCODE.')
+    print('11. Get JTAG chain device IR length.')
+    print('12. Set serial baud.')
+    print('13. Get serial baud.')
+    print('14. Set serial framing.')
+    print('15. Get serial framing.')
+    print('16. Get serial stat.')
+    print('17. Rediscover JTAG chain.')
 
 def loop(server):
     menu_format = MenuFormatBuilder().set_border_style_type(MenuBorderStyleType.HEAVY_BORDER) \
@@ -233,6 +324,21 @@ def loop(server):
     get_serial_run_menu_func = FunctionItem("Get serial server state.", get_serial_run, [main_menu, server])
     main_menu.append_item(get_serial_run_menu_func)
 
+    set_serial_baud_menu_func = FunctionItem("Set serial baud.", set_serial_baud, [main_menu, server])
+    main_menu.append_item(set_serial_baud_menu_func)
+
+    set_serial_framing_menu_func = FunctionItem("Set serial framing.", set_serial_framing, [main_menu, server])
+    main_menu.append_item(set_serial_framing_menu_func)
+
+    get_serial_settings_menu_func = FunctionItem("Get serial settings and stats.", get_serial_settings, [main_menu, server])
+    main_menu.append_item(get_serial_settings_menu_func)
+
+    get_jtag_chain_menu_func = FunctionItem("Get JTAG chain.", get_jtag_chain, [main_menu, server])
+    main_menu.append_item(get_jtag_chain_menu_func)
+
+    rediscover_jtag_chain_menu_func = FunctionItem("Rediscover JTAG chain.", rediscover_jtag_chain, [main_menu, server])
+    main_menu.append_item(rediscover_jtag_chain_menu_func)
+
     reconfig_wifi_menu_func = FunctionItem("Re-config wifi.", reconfig_wifi, [main_menu, server])
     main_menu.append_item(reconfig_wifi_menu_func)
 
@@ -252,8 +358,17 @@ def _main():
     parser = argparse.ArgumentParser(description='Communicate with XVC-Serial bridge server.')
     parser.add_argument('-i','--ip', help='server address.', default=None, required=False)
     parser.add_argument('-p','--port', help='Server command port.', default='42069', required=False, type=int)
+    parser.add_argument('-u','--udp', help='Use UDP command channel.', action='store_true')
+    parser.add_argument('-d','--discover', help='List bridges answering UDP broadcast and exit.', action='store_true')
     args = parser.parse_args()
-    cmdServer = CommandWrapper()
+    if args.discover:
+        for b in UdpCommandWrapper.discover(args.port):
+            print(b['ip'] + ' command: ' + str(b['command_port']) + \
+                  ' XVC: ' + str(b['xvc_port']) + (' (running)' if b['xvc_running'] else '') + \
+                  ' serial: ' + str(b['serial_port']) + (' (running)' if b['serial_running'] else '') + \
+                  ' boot: ' + ('SD card' if b['bootmode'] else 'NAND'))
+        return
+    cmdServer = UdpCommandWrapper() if args.udp else CommandWrapper()
     if(args.ip and args.port):
         try:
             cmdServer.connect(args.ip, args.port)
@@ -1,9 +1,17 @@
 import socket
+import struct
 import sys, os
+import time
 
 class CommandWrapper:
 
     HEADER = b'\x04\x20\x69'
+    # Commands carrying one extra data byte
+    DATA_COMMANDS = (0, 3, 5, 10, 11, 12, 14, 16)
+    # Same as server/command.h
+    BAUD_TABLE = [9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1500000, 2000000]
+    # Same order as server/serial.h
+    SERIAL_STATS = ['rx bytes', 'tx bytes', 'rx overruns', 'rx errors', 'elapsed ms', 'rx bytes/s', 'rx buffer size']
 
     def __init__(self):
         self.conn = None
@@ -20,6 +28,7 @@ class CommandWrapper:
         try:
             self.conn = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
             self.conn.connect((ip, port))
+            self.conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
             self.conn.settimeout(10)
         except socket.error as err:
             self.conn.close()
@@ -64,6 +73,15 @@ class CommandWrapper:
     * 06 get serial running state
     * 07 reconfig wifi
     * 08 reset server
+    * 09 get jtag chain device count
+    * 10 get jtag chain device idcode
+    * 11 get jtag chain device ir length
+    * 12 set serial baud, data is index in BAUD_TABLE
+    * 13 get serial baud
+    * 14 set serial framing
+    * 15 get serial framing
+    * 16 get serial stat, data is index in SERIAL_STATS
+    * 17 rediscover jtag chain
     */
     '''
     # params and return are byte arrays
@@ -87,6 +105,24 @@ class CommandWrapper:
             cmd = self.HEADER + cmd_code_case
         elif cmd_code_case == b'\x08':
             cmd = self.HEADER + cmd_code_case
+        elif cmd_code_case == b'\x09':
+            cmd = self.HEADER + cmd_code_case
+        elif cmd_code_case == b'\x0a':
+            cmd = self.HEADER + cmd_code_case + extra_data
+        elif cmd_code_case == b'\x0b':
+            cmd = self.HEADER + cmd_code_case + extra_data
+        elif cmd_code_case == b'\x0c':
+            cmd = self.HEADER + cmd_code_case + extra_data
+        elif cmd_code_case == b'\x0d':
+            cmd = self.HEADER + cmd_code_case
+        elif cmd_code_case == b'\x0e':
+            cmd = self.HEADER + cmd_code_case + extra_data
+        elif cmd_code_case == b'\x0f':
+            cmd = self.HEADER + cmd_code_case
+        elif cmd_code_case == b'\x10':
+            cmd = self.HEADER + cmd_code_case + extra_data
+        elif cmd_code_case == b'\x11':
+            cmd = self.HEADER + cmd_code_case
         return cmd
 
     def is_connected(self):
@@ -134,13 +170,126 @@ class CommandWrapper:
             print('CMD: reconfig wifi')
         elif respond[0] == 8:
             print('CMD: reset server')
+        elif respond[0] == 9:
+            print('CMD: get jtag chain device count')
+        elif respond[0] == 10:
+            print('CMD: get jtag chain device idcode')
+        elif respond[0] == 11:
+            print('CMD: get jtag chain device ir length')
+        elif respond[0] == 12:
+            print('CMD: set serial baud')
+        elif respond[0] == 13:
+            print('CMD: get serial baud')
+        elif respond[0] == 14:
+            print('CMD: set serial framing')
+        elif respond[0] == 15:
+            print('CMD: get serial framing')
+        elif respond[0] == 16:
+            print('CMD: get serial stat')
+        elif respond[0] == 17:
+            print('CMD: rediscover jtag chain')
         elif respond[0] == 100:
             print('CMD: test')
         else:
             print('UNKNOWN CMD: transmission error?')
         if respond[1] == 0:
             print('TYPE: status')
+        elif respond[1] == 1:
+            print('TYPE: discovery')
         else:
             print('UNKNOWN TYPE: transmission error?')
         print('VALUE: ' + hex(respond[2]))
         return
+
+class UdpCommandWrapper:
+
+    DISCOVER = 0xFE
+
+    # Short timeout, lost datagram is resent instead of waiting
+    def __init__(self, timeout = 0.1, retries = 20):
+        self.conn = None
+        self.port = None
+        self.ip = None
+        self.timeout = timeout
+        self.retries = retries
+        self.sequence = 0
+        return
+
+    def is_connected(self):
+        return self.conn is not None
+
+    # No connection on the wire, only fixes the peer
+    def connect(self, ip, port):
+        try:
+            socket.inet_aton(ip)
+            p = int(port)
+        except:
+            raise(Exception('Invalid IP:Port'))
+        if p < 0 or p > 65535:
+            raise(Exception('Invalid IP:Port'))
+        if self.conn is not None:
+            self.conn.close()
+        self.ip = ip
+        self.port = p
+        self.conn = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.conn.connect((ip, p))
+        self.conn.settimeout(self.timeout)
+        return
+
+    # Params as int, same return as CommandWrapper.send_command
+    def send_command(self, cmd_code_case, extra_data = 0):
+        if not self.is_connected():
+            raise Exception('Not connected')
+        self.sequence = (self.sequence + 1) & 0xFFFF
+        cmd = CommandWrapper.HEADER + self.sequence.to_bytes(2, 'little') + cmd_code_case.to_bytes(1, 'little')
+        if cmd_code_case in CommandWrapper.DATA_COMMANDS:
+            cmd += extra_data.to_bytes(1, 'little')
+        # Server resets without respond, resending would reset again after boot
+        if cmd_code_case == 7 or cmd_code_case == 8:
+            self.conn.send(cmd)
+            return ''
+        for attempt in range(0, self.retries + 1):
+            self.conn.send(cmd)
+            deadline = time.monotonic() + self.timeout
+            while time.monotonic() < deadline:
+                try:
+                    buf = self.conn.recv(64)
+                except socket.timeout:
+                    break
+                except ConnectionRefusedError:
+                    break
+                # Stale respond of an earlier request is skipped
+                if len(buf) == 11 and buf[0:3] == CommandWrapper.HEADER and \
+                        int.from_bytes(buf[3:5], 'little') == self.sequence:
+                    return [buf[5], buf[6], int.from_bytes(buf[7:11], 'little', signed = False)]
+        raise TimeoutError('No respond after ' + str(self.retries + 1) + ' attempts')
+
+    # Returns list of dict, one per bridge answering
+    @staticmethod
+    def discover(port = 42069, timeout = 1.0, address = '255.255.255.255'):
+        conn = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        conn.setsockopt(socket.SOL_SOCKET, socket.SO_BROADCAST, 1)
+        conn.settimeout(0.1)
+        cmd = CommandWrapper.HEADER + b'\x00\x00' + bytes([UdpCommandWrapper.DISCOVER])
+        bridges = {}
+        deadline = time.monotonic() + timeout
+        conn.sendto(cmd, (address, port))
+        while time.monotonic() < deadline:
+            try:
+                buf, addr = conn.recvfrom(64)
+            except socket.timeout:
+                continue
+            if len(buf) != 18 or buf[0:3] != CommandWrapper.HEADER or buf[5] != UdpCommandWrapper.DISCOVER:
+                continue
+            command_port, xvc_port, serial_port = struct.unpack('<HHH', buf[11:17])
+            bridges[addr] = {
+                'ip': socket.inet_ntoa(buf[7:11]),
+                'command_port': command_port,
+                'xvc_port': xvc_port,
+                'serial_port': serial_port,
+                'xvc_running': buf[17] & 1,
+                'serial_running': (buf[17] >> 1) & 1,
+                'bootmode': (buf[17] >> 2) & 1,
+            }
+        conn.close()
+        return list(bridges.values())
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+
+import argparse
+import asyncio
+import random
+import struct
+
+from command_wrapper import CommandWrapper
+from fleet import DATA_COMMANDS, NO_RESPOND_COMMANDS
+
+# Stand-in for server/command.h, speaks the same wire protocol without hardware
+
+class FakeBridge:
+
+    def __init__(self, latency = 0.0, drop = 0.0):
+        self.latency = latency
+        self.drop = drop
+        self.bootmode = 1
+        self.xvc_running = 0
+        self.serial_running = 0
+        # Zynq-7010 PL + ARM DAP, TDO side first
+        self.chain = [(0x03722093, 6), (0x4BA00477, 4)]
+        self.baud = 115200
+        self.framing = 0x03
+        self.port = 0
+        # addr => {(sequence, cmd_code) => respond}, least recently seen sender first, newest respond last
+        self.udp_cache = {}
+        return
+
+    def execute(self, cmd_code, data):
+        if cmd_code == 100:
+            return 0x69696969
+        elif cmd_code == 0:
+            self.bootmode = data
+            return data
+        elif cmd_code == 1:
+            return self.bootmode
+        elif cmd_code == 2:
+            return 1
+        elif cmd_code == 3:
+            self.xvc_running = int(data != 0)
+            return self.xvc_running
+        elif cmd_code == 4:
+            return self.xvc_running
+        elif cmd_code == 5:
+            self.serial_running = int(data != 0)
+            return self.serial_running
+        elif cmd_code == 6:
+            return self.serial_running
+        elif cmd_code == 9:
+            return len(self.chain) if self.xvc_running else 0
+        elif cmd_code == 10:
+            return self.chain[data][0] if self.xvc_running and data < len(self.chain) else 0
+        elif cmd_code == 11:
+            return self.chain[data][1] if self.xvc_running and data < len(self.chain) else 0
+        elif cmd_code == 12:
+            if data < len(CommandWrapper.BAUD_TABLE):
+                self.baud = CommandWrapper.BAUD_TABLE[data]
+            return self.baud
+        elif cmd_code == 13:
+            return self.baud
+        elif cmd_code == 14:
+            if (data >> 2) & 3 != 3 and (data >> 4) & 3 != 3 and data >> 6 == 0:
+                self.framing = data
+            return self.framing
+        elif cmd_code == 15:
+            return self.framing
+        elif cmd_code == 16:
+            return 0
+        elif cmd_code == 17:
+            return self.xvc_running
+        return None
+
+    # Same states as command_state_update
+    async def handle(self, reader, writer):
+        state = 0
+        cmd_code = 0
+        try:
+            while True:
+                byte = await reader.read(1)
+                if not byte:
+                    break
+                b = byte[0]
+                if state == 0:
+                    state = 1 if b == 0x04 else 0
+                elif state == 1:
+                    state = 2 if b == 0x20 else (1 if b == 0x04 else 0)
+                elif state == 2:
+                    state = 3 if b == 0x69 else (1 if b == 0x04 else 0)
+                elif state == 3:
+                    cmd_code = b
+                    if cmd_code in NO_RESPOND_COMMANDS:
+                        break
+                    elif cmd_code in DATA_COMMANDS:
+                        state = 4
+                    else:
+                        state = 0
+                        await self.respond(writer, cmd_code, self.execute(cmd_code, 0))
+                else:
+                    state = 0
+                    await self.respond(writer, cmd_code, self.execute(cmd_code, b))
+        except ConnectionError:
+            pass
+        writer.close()
+
+    async def respond(self, writer, cmd_code, value):
+        # Unknown commands are dropped silently, same as the server
+        if value is None or random.random() < self.drop:
+            return
+        if self.latency:
+            await asyncio.sleep(self.latency)
+        writer.write(CommandWrapper.HEADER + bytes([cmd_code, 0]) + value.to_bytes(4, 'little'))
+        await writer.drain()
+
+class FakeBridgeUdp(asyncio.DatagramProtocol):
+
+    SENDERS = 4
+    CACHE_DEPTH = 4
+
+    def __init__(self, bridge):
+        self.bridge = bridge
+        self.transport = None
+        return
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    # Same handling as CommandServer::handle_udp
+    def datagram_received(self, data, addr):
+        if len(data) < 6 or len(data) > 8 or data[0:3] != CommandWrapper.HEADER:
+            return
+        if random.random() < self.bridge.drop:
+            return
+        cmd_code = data[5]
+        if cmd_code == 0xFE:
+            flags = self.bridge.xvc_running | (self.bridge.serial_running << 1) | ((self.bridge.bootmode & 1) << 2)
+            self.transport.sendto(data[0:6] + b'\x01' + bytes([127, 0, 0, 1]) + \
+                                  struct.pack('<HHH', self.bridge.port, 2542, 2222) + bytes([flags]), addr)
+            return
+        senders = self.bridge.udp_cache
+        cache = senders.pop(addr, {})
+        senders[addr] = cache
+        if len(senders) > self.SENDERS:
+            del senders[next(iter(senders))]
+        key = (data[3:5], cmd_code)
+        if key not in cache:
+            if cmd_code in NO_RESPOND_COMMANDS:
+                return
+            if cmd_code in DATA_COMMANDS and len(data) < 7:
+                return
+            value = self.bridge.execute(cmd_code, data[6] if len(data) > 6 else 0)
+            if value is None:
+                return
+            cache[key] = data[0:6] + b'\x00' + value.to_bytes(4, 'little')
+            if len(cache) > self.CACHE_DEPTH:
+                del cache[next(iter(cache))]
+        self.transport.sendto(cache[key], addr)
+
+async def serve(args):
+    servers = []
+    for i in range(0, args.count):
+        bridge = FakeBridge(args.latency / 1000, args.drop)
+        bridge.port = args.base_port + i
+        servers.append(await asyncio.start_server(bridge.handle, args.ip, args.base_port + i))
+        await asyncio.get_running_loop().create_datagram_endpoint(lambda: FakeBridgeUdp(bridge), local_addr = (args.ip, args.base_port + i))
+    print('Serving ' + str(args.count) + ' fake bridges on ' + args.ip + ':' + str(args.base_port) + '-' + str(args.base_port + args.count - 1))
+    if args.hosts:
+        with open(args.hosts, 'w') as f:
+            for i in range(0, args.count):
+                f.write(args.ip + ':' + str(args.base_port + i) + '\n')
+    await asyncio.gather(*[s.serve_forever() for s in servers])
+
+def _main():
+    parser = argparse.ArgumentParser(description='Simulate many XVC-Serial bridge command servers for load testing.')
+    parser.add_argument('-n', '--count', help='Number of bridges.', default=100, type=int)
+    parser.add_argument('-i', '--ip', help='Listen address.', default='127.0.0.1')
+    parser.add_argument('-p', '--base-port', help='First port, one port per bridge.', default=42069, type=int)
+    parser.add_argument('-l', '--latency', help='Respond delay in ms.', default=0.0, type=float)
+    parser.add_argument('--drop', help='Probability to drop a respond, exercises retries.', default=0.0, type=float)
+    parser.add_argument('--hosts', help='Write target list for fleet.py -f.', default=None)
+    args = parser.parse_args()
+    try:
+        asyncio.run(serve(args))
+    except KeyboardInterrupt:
+        pass
+
+if __name__ == '__main__':
+    _main()
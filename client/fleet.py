@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+
+import argparse
+import asyncio
+import socket
+import time
+
+from command_wrapper import CommandWrapper
+
+# Commands carrying one extra data byte, others are header + code only
+DATA_COMMANDS = CommandWrapper.DATA_COMMANDS
+# Server resets instead of responding
+NO_RESPOND_COMMANDS = (7, 8)
+# Lost respond does not mean it did not run, sent once unless asked otherwise
+NOT_IDEMPOTENT_COMMANDS = (2,)
+
+class BridgeConnection:
+
+    def __init__(self, ip, port, timeout = 2.0, retries = 2, retry_reset = False):
+        self.ip = ip
+        self.port = port
+        self.timeout = timeout
+        self.retries = retries
+        self.retry_reset = retry_reset
+        self.reader = None
+        self.writer = None
+        # Server handles one command at a time per connection
+        self.lock = asyncio.Lock()
+        return
+
+    def name(self):
+        return str(self.ip) + ':' + str(self.port)
+
+    def is_connected(self):
+        return self.writer is not None and not self.writer.is_closing()
+
+    async def connect(self):
+        await self.close()
+        self.reader, self.writer = await asyncio.wait_for(asyncio.open_connection(self.ip, self.port), self.timeout)
+        sock = self.writer.get_extra_info('socket')
+        if sock is not None:
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        return
+
+    async def close(self):
+        if self.writer is not None:
+            self.writer.close()
+            try:
+                await self.writer.wait_closed()
+            except Exception:
+                pass
+        self.reader = None
+        self.writer = None
+        return
+
+    # Params as int, returns [cmd_code, type, value] like CommandWrapper.send_command
+    async def send_command(self, cmd_code, extra_data = 0):
+        cmd = CommandWrapper.HEADER + cmd_code.to_bytes(1, byteorder='little')
+        if cmd_code in DATA_COMMANDS:
+            cmd += extra_data.to_bytes(1, byteorder='little')
+        retries = self.retries
+        if cmd_code in NOT_IDEMPOTENT_COMMANDS and not self.retry_reset:
+            retries = 0
+        async with self.lock:
+            last_err = None
+            for attempt in range(0, retries + 1):
+                try:
+                    if not self.is_connected():
+                        await self.connect()
+                    self.writer.write(cmd)
+                    await asyncio.wait_for(self.writer.drain(), self.timeout)
+                    if cmd_code in NO_RESPOND_COMMANDS:
+                        await self.close()
+                        return ''
+                    buf = await asyncio.wait_for(self.reader.readexactly(9), self.timeout)
+                except (asyncio.TimeoutError, asyncio.IncompleteReadError, OSError) as err:
+                    # Late respond would desync the stream, start over on a new connection
+                    last_err = err
+                    await self.close()
+                    continue
+                if buf[0:3] != CommandWrapper.HEADER:
+                    await self.close()
+                    raise Exception('Received header mismatch: ' + buf[0:3].hex())
+                return [buf[3], buf[4], int.from_bytes(buf[5:9], 'little', signed = False)]
+            raise TimeoutError('No respond after ' + str(retries + 1) + ' attempts: ' + repr(last_err))
+
+class FleetController:
+
+    def __init__(self, targets, timeout = 2.0, retries = 2, retry_reset = False):
+        self.bridges = [BridgeConnection(ip, port, timeout, retries, retry_reset) for ip, port in targets]
+        return
+
+    async def connect_all(self):
+        results = await asyncio.gather(*[b.connect() for b in self.bridges], return_exceptions = True)
+        return [(b.name(), r) for b, r in zip(self.bridges, results) if isinstance(r, Exception)]
+
+    async def close_all(self):
+        await asyncio.gather(*[b.close() for b in self.bridges])
+        return
+
+    async def __timed_send(self, bridge, cmd_code, extra_data):
+        started = time.perf_counter()
+        try:
+            respond = await bridge.send_command(cmd_code, extra_data)
+            err = None
+        except Exception as e:
+            respond = None
+            err = e
+        return {
+            'target': bridge.name(),
+            'respond': respond,
+            'error': err,
+            'time': time.perf_counter() - started,
+        }
+
+    # One slow or dead bridge only delays its own result
+    async def send_all(self, cmd_code, extra_data = 0):
+        return await asyncio.gather(*[self.__timed_send(b, cmd_code, extra_data) for b in self.bridges])
+
+    @staticmethod
+    def summarize(results):
+        times = sorted(r['time'] for r in results if r['error'] is None)
+        summary = {'total': len(results), 'ok': len(times), 'failed': len(results) - len(times)}
+        if times:
+            summary['min'] = times[0]
+            summary['avg'] = sum(times) / len(times)
+            summary['p95'] = times[min(len(times) - 1, int(len(times) * 0.95))]
+            summary['max'] = times[-1]
+        return summary
+
+def parse_target(target, default_port):
+    if ':' in target:
+        ip, port = target.rsplit(':', 1)
+        return (ip, int(port))
+    return (target, default_port)
+
+async def run(args, targets):
+    fleet = FleetController(targets, args.timeout, args.retries, args.retry_reset)
+    for ip_port, err in await fleet.connect_all():
+        print(ip_port + ' connect failed: ' + str(err))
+    for n in range(0, args.repeat):
+        started = time.perf_counter()
+        results = await fleet.send_all(args.cmd, args.data)
+        elapsed = time.perf_counter() - started
+        if args.verbose:
+            for r in results:
+                if r['error'] is None:
+                    print(r['target'] + ' ' + str(r['respond']) + ' ' + format(r['time'] * 1000, '.2f') + 'ms')
+                else:
+                    print(r['target'] + ' FAILED ' + str(r['error']))
+        s = FleetController.summarize(results)
+        line = 'Round ' + str(n) + ': ' + str(s['ok']) + '/' + str(s['total']) + ' ok in ' + format(elapsed * 1000, '.2f') + 'ms'
+        if s['ok']:
+            line += ' (min ' + format(s['min'] * 1000, '.2f') + \
+                    ' avg ' + format(s['avg'] * 1000, '.2f') + \
+                    ' p95 ' + format(s['p95'] * 1000, '.2f') + \
+                    ' max ' + format(s['max'] * 1000, '.2f') + ' ms)'
+        print(line)
+    await fleet.close_all()
+
+def _main():
+    parser = argparse.ArgumentParser(description='Send one command to many XVC-Serial bridge servers concurrently.')
+    parser.add_argument('-t', '--target', help='IP[:port], repeatable.', action='append', default=[])
+    parser.add_argument('-f', '--file', help='File with one IP[:port] per line.', default=None)
+    parser.add_argument('-p', '--port', help='Default command port.', default=42069, type=int)
+    parser.add_argument('-c', '--cmd', help='Command code, see command_wrapper.py.', required=True, type=int)
+    parser.add_argument('-d', '--data', help='Extra data byte.', default=0, type=int)
+    parser.add_argument('-n', '--repeat', help='Send rounds.', default=1, type=int)
+    parser.add_argument('--timeout', help='Per attempt timeout in seconds.', default=2.0, type=float)
+    parser.add_argument('--retries', help='Retries after timeout, with reconnect.', default=2, type=int)
+    parser.add_argument('--retry-reset', help='Also retry reset board (2), may reset twice.', action='store_true')
+    parser.add_argument('-v', '--verbose', help='Print every respond.', action='store_true')
+    args = parser.parse_args()
+    targets = [parse_target(t, args.port) for t in args.target]
+    if args.file:
+        with open(args.file) as f:
+            targets += [parse_target(l.strip(), args.port) for l in f if l.strip() and not l.startswith('#')]
+    if not targets:
+        parser.error('No target.')
+    asyncio.run(run(args, targets))
+
+if __name__ == '__main__':
+    _main()
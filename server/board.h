@@ -0,0 +1,152 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <Arduino.h>
+
+// Select carrier board here or with -DBOARD_PROFILE=... , profiles at the end of file
+#ifndef BOARD_PROFILE
+#define BOARD_PROFILE Ebaz4205Profile
+#endif
+
+// =============================================================================================
+// Register level pin access, GPIO0-15 through GPOS / GPOC / GPI, GPIO16 lives in RTC block
+
+template <uint8_t pin>
+class FastPin
+{
+public:
+    static inline void high()
+    {
+        GPOS = mask;
+    }
+
+    static inline void low()
+    {
+        GPOC = mask;
+    }
+
+    static inline void write(uint8_t value)
+    {
+        if (value)
+            high();
+        else
+            low();
+    }
+
+    static inline uint8_t read()
+    {
+        return (GPI & mask) != 0;
+    }
+
+private:
+    static_assert(pin < 16, "GPIO16 has its own specialization");
+    static constexpr const uint32_t mask = (1 << pin);
+};
+
+template <>
+class FastPin<16>
+{
+public:
+    static inline void high()
+    {
+        GP16O |= 1;
+    }
+
+    static inline void low()
+    {
+        GP16O &= ~1;
+    }
+
+    static inline void write(uint8_t value)
+    {
+        if (value)
+            high();
+        else
+            low();
+    }
+
+    static inline uint8_t read()
+    {
+        return GP16I & 1;
+    }
+};
+
+// =============================================================================================
+// Pin rules
+// https://randomnerdtutorials.com/esp8266-pinout-reference-gpios/
+//  - GPIO6-11 are wired to the SPI flash
+//  - GPIO0, GPIO2 must be high and GPIO15 low at boot
+//  - UART0 is GPIO1 (TX) / GPIO3 (RX)
+
+constexpr bool pin_is_usable(uint8_t pin)
+{
+    return pin <= 16 && !(pin >= 6 && pin <= 11);
+}
+
+constexpr bool pin_is_strapping(uint8_t pin)
+{
+    return pin == 0 || pin == 2 || pin == 15;
+}
+
+constexpr uint32_t pin_bit(uint8_t pin)
+{
+    return (uint32_t)1 << pin;
+}
+
+constexpr uint8_t pin_count(uint32_t pins)
+{
+    return pins ? (pins & 1) + pin_count(pins >> 1) : 0;
+}
+
+// =============================================================================================
+
+template <uint8_t rst,
+          uint8_t bootmode_control,
+          uint8_t bootmode_selector,
+          uint8_t tck,
+          uint8_t tdo,
+          uint8_t tdi,
+          uint8_t tms,
+          uint8_t serial_tx,
+          uint8_t serial_rx>
+struct BoardProfile
+{
+    static constexpr const uint8_t rst_pin               = rst;
+    static constexpr const uint8_t bootmode_control_pin  = bootmode_control;
+    static constexpr const uint8_t bootmode_selector_pin = bootmode_selector;
+    static constexpr const uint8_t tck_pin               = tck;
+    static constexpr const uint8_t tdo_pin               = tdo;
+    static constexpr const uint8_t tdi_pin               = tdi;
+    static constexpr const uint8_t tms_pin               = tms;
+    static constexpr const uint8_t serial_tx_pin         = serial_tx;
+    static constexpr const uint8_t serial_rx_pin         = serial_rx;
+
+    static_assert(pin_is_usable(rst) && pin_is_usable(bootmode_control) && pin_is_usable(bootmode_selector) &&
+                  pin_is_usable(tck) && pin_is_usable(tdo) && pin_is_usable(tdi) && pin_is_usable(tms),
+                  "Pin does not exist or is used by SPI flash");
+    static_assert(pin_count(pin_bit(rst) | pin_bit(bootmode_control) | pin_bit(bootmode_selector) |
+                            pin_bit(tck) | pin_bit(tdo) | pin_bit(tdi) | pin_bit(tms) |
+                            pin_bit(serial_tx) | pin_bit(serial_rx)) == 9,
+                  "Two roles share the same pin");
+    // Target circuitry decides the level of these at power up, keep them off strapping pins
+    static_assert(!pin_is_strapping(rst) && !pin_is_strapping(bootmode_control) &&
+                  !pin_is_strapping(tck) && !pin_is_strapping(tdo) &&
+                  !pin_is_strapping(tdi) && !pin_is_strapping(tms),
+                  "Reset, bootmode control and JTAG pins must not use GPIO0/2/15");
+    // Button to GND with pullup reads high at boot, fine for GPIO0/2 but not GPIO15
+    static_assert(bootmode_selector != 15, "Bootmode selector is pulled up, GPIO15 must boot low");
+    // JtagPort builds GPOS / GPOC masks directly
+    static_assert(tck < 16 && tdo < 16 && tdi < 16 && tms < 16, "JTAG pins must be GPIO0-15");
+    static_assert(serial_tx == 1 && serial_rx == 3, "Serial bridge uses UART0 on GPIO1 / GPIO3");
+};
+
+// =============================================================================================
+// Profiles, reference in README pinouts
+// Add one line per carrier with its own mod points, do not alias boards whose pins are not verified
+
+//                      RST  BM_CTRL  BM_SEL  TCK  TDO  TDI  TMS  TX  RX
+typedef BoardProfile<   16,  5,       2,      14,  12,  13,  4,   1,  3>  Ebaz4205Profile;
+
+typedef BOARD_PROFILE Board;
+
+#endif
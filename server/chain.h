@@ -0,0 +1,247 @@
+#ifndef CHAIN_H
+#define CHAIN_H
+
+#include <Arduino.h>
+
+#define CHAIN_MAX_DEVICES 8
+#define CHAIN_MAX_IR_BITS 64
+
+// =============================================================================================
+// Scan chain discovery through a JtagPort
+//  - IDCODE / BYPASS from Test-Logic-Reset DR scan
+//  - Total IR length by flushing ones through Shift-IR
+//  - Per device IR length from known parts, else from the captured "...01" IR patterns
+// Device 0 is the one closest to TDO, same order as the DR scan shifts them out
+
+template <typename jtag_port>
+class JtagChain
+{
+public:
+
+    JtagChain()
+    {
+        invalidate();
+    }
+
+    void invalidate()
+    {
+        valid = 0;
+        count = 0;
+        ir_total = 0;
+    }
+
+    // Returns number of devices found, 0 on failure
+    uint8_t discover()
+    {
+        invalidate();
+        tap_reset();
+        if (scan_idcodes() && scan_ir_lengths())
+            valid = 1;
+        else
+            count = 0;
+        tap_reset();
+        jtag_port::tck_low();
+        return count;
+    }
+
+    uint8_t is_valid() const
+    {
+        return valid;
+    }
+
+    uint8_t device_count() const
+    {
+        return count;
+    }
+
+    // 0 for devices in BYPASS after reset
+    uint32_t idcode(uint8_t index) const
+    {
+        return (index < count) ? idcodes[index] : 0;
+    }
+
+    // 0 when it could not be resolved
+    uint8_t ir_length(uint8_t index) const
+    {
+        return (index < count) ? ir_lengths[index] : 0;
+    }
+
+    // Every device resolved and adding up to the measured IR length
+    bool ir_lengths_resolved() const
+    {
+        uint8_t sum = 0;
+        for (uint8_t index = 0; index < count; index++) {
+            if (ir_lengths[index] == 0)
+                return false;
+            sum += ir_lengths[index];
+        }
+        return count > 0 && sum == ir_total;
+    }
+
+    // Position of the first ARM DAP for JtagDap::set_chain
+    bool find_dap(uint8_t &ir_tdo, uint8_t &ir_tdi, uint8_t &dr_tdo, uint8_t &dr_tdi) const
+    {
+        if (!valid || !ir_lengths_resolved())
+            return false;
+        for (uint8_t index = 0; index < count; index++) {
+            if (manufacturer(idcodes[index]) != MANUFACTURER_ARM || ir_lengths[index] != 4)
+                continue;
+            ir_tdo = 0;
+            ir_tdi = 0;
+            for (uint8_t other = 0; other < count; other++) {
+                if (other < index)
+                    ir_tdo += ir_lengths[other];
+                else if (other > index)
+                    ir_tdi += ir_lengths[other];
+            }
+            dr_tdo = index;
+            dr_tdi = count - index - 1;
+            return true;
+        }
+        return false;
+    }
+
+private:
+
+    static constexpr const uint16_t MANUFACTURER_ARM    = 0x23B;
+    static constexpr const uint16_t MANUFACTURER_XILINX = 0x049;
+
+    static uint16_t manufacturer(uint32_t idcode)
+    {
+        return (idcode >> 1) & 0x7FF;
+    }
+
+    // IR length fixed by specification
+    static uint8_t fixed_ir_length(uint32_t idcode)
+    {
+        if (idcode != 0 && manufacturer(idcode) == MANUFACTURER_ARM)
+            return 4;   // JTAG-DP
+        return 0;
+    }
+
+    // Most likely IR length, Xilinx parts range from 6 to 38
+    static uint8_t known_ir_length(uint32_t idcode)
+    {
+        if (idcode != 0 && manufacturer(idcode) == MANUFACTURER_XILINX)
+            return 6;   // 7 series / Zynq-7000 PL
+        return fixed_ir_length(idcode);
+    }
+
+    // Test-Logic-Reset then Run-Test/Idle
+    static void tap_reset()
+    {
+        for (uint8_t index = 0; index < 5; index++)
+            jtag_port::step(1, 0);
+        jtag_port::step(0, 0);
+    }
+
+    // After reset every DR is IDCODE (LSB 1) or BYPASS (single 0), shifting ones marks the end
+    bool scan_idcodes()
+    {
+        jtag_port::step(1, 0); // Select-DR
+        jtag_port::step(0, 0); // Capture-DR
+        jtag_port::step(0, 0); // Shift-DR
+        bool ended = false;
+        while (count <= CHAIN_MAX_DEVICES) {
+            uint32_t idcode = 0;
+            if (jtag_port::step(0, 1)) {
+                idcode = 1;
+                for (uint8_t bit = 1; bit < 32; bit++)
+                    if (jtag_port::step(0, 1))
+                        idcode |= (uint32_t)1 << bit;
+                if (idcode == 0xFFFFFFFF) {
+                    ended = true;
+                    break;
+                }
+            }
+            if (count < CHAIN_MAX_DEVICES)
+                idcodes[count] = idcode;
+            count++;
+        }
+        jtag_port::step(1, 1); // Exit1-DR
+        jtag_port::step(1, 0); // Update-DR
+        jtag_port::step(0, 0); // Run-Test/Idle
+        return ended && count > 0;
+    }
+
+    bool scan_ir_lengths()
+    {
+        jtag_port::step(1, 0); // Select-DR
+        jtag_port::step(1, 0); // Select-IR
+        jtag_port::step(0, 0); // Capture-IR
+        jtag_port::step(0, 0); // Shift-IR
+        // Captured patterns come out first, chain is all ones afterwards
+        uint64_t captured = 0;
+        for (uint8_t bit = 0; bit < CHAIN_MAX_IR_BITS; bit++)
+            if (jtag_port::step(0, 1))
+                captured |= (uint64_t)1 << bit;
+        // Single zero marker, total length is how long it takes to come out
+        jtag_port::step(0, 0);
+        uint8_t total = 0;
+        for (uint8_t bit = 1; bit <= CHAIN_MAX_IR_BITS && total == 0; bit++)
+            if (!jtag_port::step(0, 1))
+                total = bit;
+        // Ones left in every IR => BYPASS
+        jtag_port::step(1, 1); // Exit1-IR
+        jtag_port::step(1, 0); // Update-IR
+        jtag_port::step(0, 0); // Run-Test/Idle
+        if (total == 0)
+            return false;
+        resolve_ir_lengths(captured, total);
+        return true;
+    }
+
+    // Table first, when it does not add up to the measured length only trust the JTAG-DP
+    void resolve_ir_lengths(uint64_t captured, uint8_t total)
+    {
+        ir_total = total;
+        for (uint8_t pass = 0; pass < 2; pass++) {
+            uint8_t known_total = 0;
+            uint8_t unknown = 0;
+            for (uint8_t index = 0; index < count; index++) {
+                ir_lengths[index] = pass ? fixed_ir_length(idcodes[index]) : known_ir_length(idcodes[index]);
+                known_total += ir_lengths[index];
+                if (ir_lengths[index] == 0)
+                    unknown++;
+            }
+            if (unknown == 1) {
+                for (uint8_t index = 0; index < count; index++)
+                    if (ir_lengths[index] == 0 && total > known_total + 1)
+                        ir_lengths[index] = total - known_total;
+            } else if (unknown > 1) {
+                parse_captured(captured, total);
+            }
+            if (ir_lengths_resolved())
+                return;
+        }
+        // Nothing adds up => leave all unresolved
+        for (uint8_t index = 0; index < count; index++)
+            ir_lengths[index] = 0;
+    }
+
+    // Unknown device ends right before the next "01" capture pattern
+    void parse_captured(uint64_t captured, uint8_t total)
+    {
+        uint8_t offset = 0;
+        for (uint8_t index = 0; index < count && offset < total; index++) {
+            if (ir_lengths[index] == 0) {
+                uint8_t length = 2;
+                while (offset + length < total &&
+                       !(((captured >> (offset + length)) & 1) && !((captured >> (offset + length + 1)) & 1)))
+                    length++;
+                ir_lengths[index] = length;
+            }
+            offset += ir_lengths[index];
+        }
+    }
+
+private:
+
+    uint8_t valid;
+    uint8_t count;
+    uint8_t ir_total;
+    uint32_t idcodes[CHAIN_MAX_DEVICES];
+    uint8_t ir_lengths[CHAIN_MAX_DEVICES];
+};
+
+#endif
@@ -4,15 +4,18 @@
 #include <Arduino.h>
 #include <WiFiManager.h>
 #include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+#include "board.h"
 #include "xvc.h"
 #include "serial.h"
 
 #define COMMAND_SEND_BUFFER_SIZE 9
 #define COMMAND_PORT 42069
-
-#define COMMAND_RST_PIN               16
-#define COMMAND_BOOTMODE_CONTROL_PIN  5
-#define COMMAND_BOOTMODE_SELECTOR_PIN 2
+#define COMMAND_UDP_BUFFER_SIZE 8
+#define COMMAND_UDP_REPLY_SIZE 18
+#define COMMAND_UDP_SENDERS 4     // senders with own reply cache, least recently seen replaced
+#define COMMAND_UDP_CACHE_DEPTH 4 // last replies kept per sender
+#define COMMAND_UDP_DISCOVER 0xFE
 
 const char string_0[] PROGMEM = "[LOG]"; 
 const char string_1[] PROGMEM = "STARTING COMMAND SERVER...";
@@ -22,48 +25,51 @@ const char* const string_table[] PROGMEM = {string_0, string_1};
 
 // =============================================================================================
 
-template <uint8_t rst_pin,
-          uint8_t bootmode_control_pin,
-          uint8_t bootmode_selector_pin>
+template <typename board>
 class CommandPort
 {
 public:
     static void begin(uint8_t bootmode)
     {
-        pinMode(rst_pin, OUTPUT);
-        digitalWrite(rst_pin, 0); // keep board under reset
-        pinMode(bootmode_control_pin, OUTPUT);
+        pinMode(board::rst_pin, OUTPUT);
+        rst::low(); // keep board under reset
+        pinMode(board::bootmode_control_pin, OUTPUT);
         set_bootmode(bootmode);
-        pinMode(bootmode_selector_pin, INPUT);
+        pinMode(board::bootmode_selector_pin, INPUT);
         
     }
 
     static void set_bootmode(uint8_t bootmode)
     {
-        digitalWrite(bootmode_control_pin, bootmode);
+        bootmode_control::write(bootmode);
     }
 
     static void pulse_reset()
     {
-        digitalWrite(rst_pin, 0);
+        rst::low();
         delay(5);
-        digitalWrite(rst_pin, 1);
+        rst::high();
     }
 
     static void pull_reset_down()
     {
-        digitalWrite(rst_pin, 0);
+        rst::low();
     }
 
     static void pull_reset_up()
     {
-        digitalWrite(rst_pin, 1);
+        rst::high();
     }
 
     static uint8_t read_boot_selector()
     {
-        return digitalRead(bootmode_selector_pin);
+        return bootmode_selector::read();
     }
+
+private:
+    typedef FastPin<board::rst_pin> rst;
+    typedef FastPin<board::bootmode_control_pin> bootmode_control;
+    typedef FastPin<board::bootmode_selector_pin> bootmode_selector;
 };
 
 // =============================================================================================
@@ -84,6 +90,20 @@ public:
  * => 9 bytes
  */
 
+/* UDP, same port number as TCP, no connection needed
+ * Request: header, 2 bytes sequence (LE), cmd code, optional data byte => 6 to 7 bytes
+ * Return:  header, 2 bytes sequence, cmd code, return type, 4 bytes data => 11 bytes
+ *  - Retransmitted request (same sender, sequence, cmd code) gets the cached return, not executed again
+ *    while it is one of the sender's last COMMAND_UDP_CACHE_DEPTH commands and the sender is one of
+ *    the last COMMAND_UDP_SENDERS seen
+ *  - Reset self / reconfig wifi still do not return, send once
+ *  - Not sent to this bridge's own address (broadcast, multicast) => only discovery is answered
+ * Discovery, cmd code 0xFE, may be broadcast, type 1:
+ *  - 4 bytes IPv4, 2 bytes each command / xvc / serial port (LE)
+ *  - 1 byte state: bit 0 xvc running, bit 1 serial running, bit 2 bootmode
+ * => 18 bytes
+ */
+
 /* CMD Codes
  * 00 set boot mode
  * 01 get boot mode
@@ -94,8 +114,19 @@ public:
  * 06 get serial running status
  * 07 reconfig wifi
  * 08 reset self
+ * 09 get jtag chain device count, cached (0 when not discovered or failed)
+ * 10 get jtag chain device idcode, data: device index from TDO side
+ * 11 get jtag chain device ir length, data: device index from TDO side
+ * 12 set serial baud, data: index in serial_baud_table, returns baud in use
+ * 13 get serial baud
+ * 14 set serial framing, data: framing byte (serial.h), returns framing in use
+ * 15 get serial framing
+ * 16 get serial stat, data: stat index (serial.h)
+ * 17 rediscover jtag chain, runs once no xvc client is connected, returns 1 when scheduled
  */
 
+const uint32_t serial_baud_table[] = {9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1500000, 2000000};
+
 // =============================================================================================
 
 template <typename command_port>
@@ -152,6 +183,7 @@ public:
         
         server.begin();
         server.setNoDelay(true);
+        udp.begin((port != 0) ? port : COMMAND_PORT);
     }
 
     // Loop always running
@@ -162,6 +194,8 @@ public:
         // Service loop
         serial_server.handle();
         xvc_server.handle();
+        // Connectionless command loop
+        handle_udp();
         // Command loop
         if(!client || !client.connected()) {
             client = server.available();
@@ -224,6 +258,8 @@ private:
     uint32_t reset_board()
     {
         command_port::pulse_reset();
+        if (xvc_server.is_running())
+            xvc_server.schedule_chain_discovery(XVC_CHAIN_RESCAN_DELAY);
         return 1;
     }
 
@@ -260,6 +296,54 @@ private:
         return 0;
     }
 
+    uint32_t set_serial_baud(uint8_t index)
+    {
+        if (index < sizeof(serial_baud_table) / sizeof(serial_baud_table[0]))
+            serial_server.set_baud(serial_baud_table[index]);
+        return serial_server.get_baud();
+    }
+
+    uint32_t get_serial_baud()
+    {
+        return serial_server.get_baud();
+    }
+
+    uint32_t set_serial_framing(uint8_t framing)
+    {
+        return serial_server.set_framing(framing);
+    }
+
+    uint32_t get_serial_framing()
+    {
+        return serial_server.get_framing();
+    }
+
+    uint32_t get_serial_stat(uint8_t index)
+    {
+        return serial_server.get_stat(index);
+    }
+
+    uint32_t get_jtag_chain_count()
+    {
+        return xvc_server.get_chain().device_count();
+    }
+
+    uint32_t rediscover_jtag_chain()
+    {
+        xvc_server.schedule_chain_discovery(0);
+        return xvc_server.is_chain_discovery_pending();
+    }
+
+    uint32_t get_jtag_chain_idcode(uint8_t index)
+    {
+        return xvc_server.get_chain().idcode(index);
+    }
+
+    uint32_t get_jtag_chain_ir_length(uint8_t index)
+    {
+        return xvc_server.get_chain().ir_length(index);
+    }
+
     // ~ API handlers
 
     // Loop helper
@@ -298,9 +382,126 @@ private:
         command_send_buffer_counter = 0;
     }
 
+    // One datagram per pass, same fairness as the TCP loop
+    void handle_udp()
+    {
+        int size = udp.parsePacket();
+        if (size <= 0)
+            return;
+        // Unread datagram is dropped by the next parsePacket
+        uint8_t request[COMMAND_UDP_BUFFER_SIZE];
+        if (size < 6 || size > COMMAND_UDP_BUFFER_SIZE)
+            return;
+        udp.read(request, size);
+        if (memcmp(request, "\x04\x20\x69", 3) != 0)
+            return;
+        IPAddress remote_ip = udp.remoteIP();
+        uint16_t remote_port = udp.remotePort();
+        uint16_t sequence = request[3] | (request[4] << 8);
+        uint8_t code = request[5];
+
+        if (code == COMMAND_UDP_DISCOVER) {
+            uint8_t reply[COMMAND_UDP_REPLY_SIZE];
+            prepare_udp_discovery(reply, sequence);
+            udp_send(remote_ip, remote_port, reply, COMMAND_UDP_REPLY_SIZE);
+            return;
+        }
+        // One broadcast must not reset / reconfigure every bridge on the network
+        bool unicast = udp.destinationIP() == WiFi.localIP();
+        if (!unicast)
+            return;
+
+        UdpSender &sender = udp_senders[udp_find_sender(remote_ip, remote_port)];
+        for (uint8_t index = 0; index < COMMAND_UDP_CACHE_DEPTH; index++) {
+            UdpCacheEntry &entry = sender.cache[index];
+            if (entry.length && entry.sequence == sequence && entry.code == code) {
+                udp_send(remote_ip, remote_port, entry.reply, entry.length);
+                return;
+            }
+        }
+
+        uint32_t value;
+        uint8_t type = execute_udp(request + 5, size - 5, value);
+        if (type == 255)
+            return;
+        UdpCacheEntry &entry = sender.cache[sender.cache_next];
+        sender.cache_next = (sender.cache_next + 1) % COMMAND_UDP_CACHE_DEPTH;
+        entry.sequence = sequence;
+        entry.code = code;
+        memcpy(entry.reply, request, 6);
+        entry.reply[6] = type;
+        memcpy(&entry.reply[7], &value, 4);
+        entry.length = 11;
+        udp_send(remote_ip, remote_port, entry.reply, entry.length);
+    }
+
+    // Known sender, else take over the least recently seen one with an empty cache
+    uint8_t udp_find_sender(const IPAddress &ip, uint16_t remote_port)
+    {
+        uint32_t now = millis();
+        uint8_t oldest = 0;
+        for (uint8_t index = 0; index < COMMAND_UDP_SENDERS; index++) {
+            UdpSender &sender = udp_senders[index];
+            if (sender.port == remote_port && sender.ip == ip) {
+                sender.last_seen = now;
+                return index;
+            }
+            if (udp_senders[oldest].port != 0 &&
+                (sender.port == 0 || now - sender.last_seen > now - udp_senders[oldest].last_seen))
+                oldest = index;
+        }
+        UdpSender &sender = udp_senders[oldest];
+        sender.ip = ip;
+        sender.port = remote_port;
+        sender.last_seen = now;
+        sender.cache_next = 0;
+        for (uint8_t index = 0; index < COMMAND_UDP_CACHE_DEPTH; index++)
+            sender.cache[index].length = 0;
+        return oldest;
+    }
+
+    // Run cmd code + data through the TCP state machine without disturbing a TCP command in flight
+    uint8_t execute_udp(const uint8_t *command, uint8_t length, uint32_t &value)
+    {
+        uint8_t saved_state = command_state;
+        uint8_t saved_code = command_code;
+        uint32_t saved_value = command_return_value;
+        uint8_t type = 255;
+        command_state = 3; // header already checked
+        for (uint8_t index = 0; index < length && type == 255; index++)
+            type = command_state_update(command[index]);
+        value = command_return_value;
+        command_state = saved_state;
+        command_code = saved_code;
+        command_return_value = saved_value;
+        return type;
+    }
+
+    void prepare_udp_discovery(uint8_t *reply, uint16_t sequence)
+    {
+        IPAddress ip = WiFi.localIP();
+        uint16_t ports[3] = {(uint16_t)((port != 0) ? port : COMMAND_PORT), XVC_PORT, SERIAL_PORT};
+        memcpy(reply, "\x04\x20\x69", 3);
+        memcpy(&reply[3], &sequence, 2);
+        reply[5] = COMMAND_UDP_DISCOVER;
+        reply[6] = 1;
+        for (uint8_t index = 0; index < 4; index++)
+            reply[7 + index] = ip[index];
+        memcpy(&reply[11], ports, 6);
+        reply[17] = xvc_server.is_running() | (serial_server.is_running() << 1) | ((bootmode & 1) << 2);
+    }
+
+    void udp_send(const IPAddress &ip, uint16_t remote_port, const uint8_t *data, uint8_t length)
+    {
+        udp.beginPacket(ip, remote_port);
+        udp.write(data, length);
+        udp.endPacket();
+    }
+
     /* Return vals => data type in respond request
     * 255: Nothing executed, else check command_return_value
     * 0  : Status
+    * 1  : Discovery, UDP only
     * ?  : ? Add later
     */
     uint8_t command_state_update(const uint8_t& data)
@@ -365,6 +566,32 @@ SET_STATE_4:
                         command_return_value = reset_self();
                         ret_val = 0;
                         goto RESET_STATE_0;
+                    case 9:
+                        command_return_value = get_jtag_chain_count();
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 10:
+                        goto SET_STATE_4;
+                    case 11:
+                        goto SET_STATE_4;
+                    case 12:
+                        goto SET_STATE_4;
+                    case 13:
+                        command_return_value = get_serial_baud();
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 14:
+                        goto SET_STATE_4;
+                    case 15:
+                        command_return_value = get_serial_framing();
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 16:
+                        goto SET_STATE_4;
+                    case 17:
+                        command_return_value = rediscover_jtag_chain();
+                        ret_val = 0;
+                        goto RESET_STATE_0;
                     default:
                         goto STATE_UNK_CMD;
                 }
@@ -383,6 +610,26 @@ SET_STATE_4:
                         command_return_value = set_serial_run_state(data);
                         ret_val = 0;
                         goto RESET_STATE_0;
+                    case 10:
+                        command_return_value = get_jtag_chain_idcode(data);
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 11:
+                        command_return_value = get_jtag_chain_ir_length(data);
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 12:
+                        command_return_value = set_serial_baud(data);
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 14:
+                        command_return_value = set_serial_framing(data);
+                        ret_val = 0;
+                        goto RESET_STATE_0;
+                    case 16:
+                        command_return_value = get_serial_stat(data);
+                        ret_val = 0;
+                        goto RESET_STATE_0;
                     default:
 STATE_UNK_CMD:
                         goto RESET_STATE;
@@ -407,9 +654,28 @@ RESET_STATE_0:
 
 private:
 
+    struct UdpCacheEntry
+    {
+        uint16_t sequence;
+        uint8_t code;
+        uint8_t length = 0; // 0 => empty
+        uint8_t reply[11];
+    };
+
+    struct UdpSender
+    {
+        IPAddress ip;
+        uint16_t port = 0; // 0 => unused
+        uint32_t last_seen = 0;
+        uint8_t cache_next = 0;
+        UdpCacheEntry cache[COMMAND_UDP_CACHE_DEPTH];
+    };
+
     WiFiServer server;
     WiFiClient client;
     WiFiManager wifiManager;
+    WiFiUDP udp;
+    UdpSender udp_senders[COMMAND_UDP_SENDERS];
 
     uint16_t port;
     uint8_t command_code;
@@ -422,9 +688,9 @@ private:
     uint8_t command_send_buffer_counter = 0; // 1 byte only 255 max
 
     SerialServer serial_server;
-    XvcServer<JtagPort<XVC_TCK, XVC_TDO, XVC_TDI, XVC_TMS>> xvc_server;
+    XvcServer<JtagPort<Board::tck_pin, Board::tdo_pin, Board::tdi_pin, Board::tms_pin>> xvc_server;
 };
 
-extern CommandServer<CommandPort<COMMAND_RST_PIN, COMMAND_BOOTMODE_CONTROL_PIN, COMMAND_BOOTMODE_SELECTOR_PIN>> command_server;
+extern CommandServer<CommandPort<Board>> command_server;
 
 #endif
@@ -0,0 +1,281 @@
+#ifndef DAP_H
+#define DAP_H
+
+#include <Arduino.h>
+
+// Default DAP position, Zynq-7000 cascade chain: TDI -> ARM DAP (IR 4) -> PL TAP (IR 6) -> TDO
+// TDO side bits are shifted first
+#define DAP_IR_TDO_SIDE 6
+#define DAP_IR_TDI_SIDE 0
+#define DAP_DR_TDO_SIDE 1 // devices in bypass
+#define DAP_DR_TDI_SIDE 0
+
+#define DAP_MEM_AP       0   // AHB-AP, system memory view on Zynq-7000
+#define DAP_WAIT_RETRIES 100
+
+// =============================================================================================
+// ADIv5 JTAG-DP access through a JtagPort, 32 bit memory transfers over MEM-AP
+// https://developer.arm.com/documentation/ihi0031/latest
+
+template <typename jtag_port>
+class JtagDap
+{
+    // JTAG-DP instructions
+    static constexpr const uint8_t IR_DPACC  = 0xA;
+    static constexpr const uint8_t IR_APACC  = 0xB;
+    static constexpr const uint8_t IR_LENGTH = 4;
+    static constexpr const uint8_t IR_UNKNOWN = 0xFF;
+
+    // DPACC / APACC scan: RnW + A[3:2] + 32 bit data, ACK in the low 3 bits of the capture
+    static constexpr const uint8_t DR_LENGTH = 35;
+    static constexpr const uint8_t ACK_OK    = 0x2;
+    static constexpr const uint8_t ACK_WAIT  = 0x1;
+
+    // DP registers
+    static constexpr const uint8_t DP_CTRL_STAT = 0x4;
+    static constexpr const uint8_t DP_SELECT    = 0x8;
+    static constexpr const uint8_t DP_RDBUFF    = 0xC;
+
+    static constexpr const uint32_t CTRL_POWER_REQ = (1UL << 30) | (1UL << 28); // CSYSPWRUPREQ | CDBGPWRUPREQ
+    static constexpr const uint32_t CTRL_POWER_ACK = (1UL << 31) | (1UL << 29);
+    static constexpr const uint32_t CTRL_STICKY    = (1UL << 5) | (1UL << 4) | (1UL << 1); // write 1 to clear on JTAG-DP
+    static constexpr const uint32_t CTRL_STICKYERR = (1UL << 5);
+
+    // MEM-AP registers, bank 0
+    static constexpr const uint8_t AP_CSW = 0x0;
+    static constexpr const uint8_t AP_TAR = 0x4;
+    static constexpr const uint8_t AP_DRW = 0xC;
+
+    // 32 bit, single auto increment, privileged debug master
+    static constexpr const uint32_t CSW_VALUE = 0x23000012;
+    // Auto increment only guaranteed inside 1KB
+    static constexpr const uint32_t TAR_WRAP_MASK = 0x3FF;
+
+public:
+
+    enum Status : uint8_t
+    {
+        Ok = 0,
+        Unaligned,
+        Wait,
+        ProtocolError,
+        Fault,
+        NoDap,      // discovered chain has no usable DAP
+    };
+
+    JtagDap()
+    {
+        set_default_chain();
+        current_ir = IR_UNKNOWN;
+    }
+
+    void set_default_chain()
+    {
+        set_chain(DAP_IR_TDO_SIDE, DAP_IR_TDI_SIDE, DAP_DR_TDO_SIDE, DAP_DR_TDI_SIDE);
+    }
+
+    // Bits of other TAPs around the DAP, IR in instruction bits, DR in bypass devices
+    void set_chain(uint8_t ir_tdo, uint8_t ir_tdi, uint8_t dr_tdo, uint8_t dr_tdi)
+    {
+        ir_tdo_side = ir_tdo;
+        ir_tdi_side = ir_tdi;
+        dr_tdo_side = dr_tdo;
+        dr_tdi_side = dr_tdi;
+        present = 1;
+    }
+
+    // Memory access fails with NoDap until the next set_chain
+    void set_absent()
+    {
+        present = 0;
+    }
+
+    // Word count of 32 bit little endian data, address must be word aligned
+    Status read(uint32_t address, uint32_t words, uint8_t *data)
+    {
+        if (!present)
+            return NoDap;
+        if (address & 3)
+            return Unaligned;
+        Status status = prepare();
+        bool pending = false;
+        uint32_t value;
+        for (uint32_t index = 0; status == Ok && index < words; index++) {
+            uint32_t word_address = address + index * 4;
+            // Every scan captures the result of the previous read
+            if (index == 0 || (word_address & TAR_WRAP_MASK) == 0) {
+                status = transfer(IR_APACC, AP_TAR, false, word_address, &value);
+                if (status == Ok && pending) {
+                    store_le32(data + (index - 1) * 4, value);
+                    pending = false;
+                }
+            }
+            if (status == Ok) {
+                status = transfer(IR_APACC, AP_DRW, true, 0, &value);
+                if (status == Ok && pending)
+                    store_le32(data + (index - 1) * 4, value);
+                pending = true;
+            }
+        }
+        if (status == Ok && pending) {
+            status = transfer(IR_DPACC, DP_RDBUFF, true, 0, &value);
+            if (status == Ok)
+                store_le32(data + (words - 1) * 4, value);
+        }
+        return finish(status);
+    }
+
+    Status write(uint32_t address, uint32_t words, const uint8_t *data)
+    {
+        if (!present)
+            return NoDap;
+        if (address & 3)
+            return Unaligned;
+        Status status = prepare();
+        for (uint32_t index = 0; status == Ok && index < words; index++) {
+            uint32_t word_address = address + index * 4;
+            if (index == 0 || (word_address & TAR_WRAP_MASK) == 0)
+                status = transfer(IR_APACC, AP_TAR, false, word_address, nullptr);
+            if (status == Ok)
+                status = transfer(IR_APACC, AP_DRW, false, load_le32(data + index * 4), nullptr);
+        }
+        return finish(status);
+    }
+
+private:
+
+    // Client may have left the TAP anywhere, also another debugger may have touched the AP
+    Status prepare()
+    {
+        tap_reset();
+        Status status = transfer(IR_DPACC, DP_CTRL_STAT, false, CTRL_POWER_REQ | CTRL_STICKY, nullptr);
+        uint32_t ctrl = 0;
+        for (uint32_t retry = 0; status == Ok && (ctrl & CTRL_POWER_ACK) != CTRL_POWER_ACK; retry++) {
+            if (retry == DAP_WAIT_RETRIES) {
+                status = Wait;
+                break;
+            }
+            status = read_dp(DP_CTRL_STAT, &ctrl);
+        }
+        if (status == Ok)
+            status = transfer(IR_DPACC, DP_SELECT, false, (uint32_t)DAP_MEM_AP << 24, nullptr);
+        if (status == Ok)
+            status = transfer(IR_APACC, AP_CSW, false, CSW_VALUE, nullptr);
+        return status;
+    }
+
+    // Reading CTRL/STAT also waits for the last posted transfer
+    Status finish(Status status)
+    {
+        uint32_t ctrl;
+        if (status == Ok)
+            status = read_dp(DP_CTRL_STAT, &ctrl);
+        if (status == Ok && (ctrl & CTRL_STICKYERR)) {
+            transfer(IR_DPACC, DP_CTRL_STAT, false, CTRL_POWER_REQ | CTRL_STICKY, nullptr);
+            status = Fault;
+        }
+        jtag_port::tck_low();
+        return status;
+    }
+
+    Status read_dp(uint8_t reg, uint32_t *value)
+    {
+        Status status = transfer(IR_DPACC, reg, true, 0, nullptr);
+        if (status == Ok)
+            status = transfer(IR_DPACC, DP_RDBUFF, true, 0, value);
+        return status;
+    }
+
+    // Returns the data captured by this scan => result of the previous read
+    Status transfer(uint8_t ir, uint8_t reg, bool read, uint32_t value, uint32_t *captured)
+    {
+        scan_ir(ir);
+        uint64_t request = ((uint64_t)value << 3) | ((reg >> 1) & 0x6) | (read ? 1 : 0);
+        for (uint32_t retry = 0; retry < DAP_WAIT_RETRIES; retry++) {
+            uint64_t response = scan_dr(request);
+            uint8_t ack = response & 0x7;
+            if (ack == ACK_OK) {
+                if (captured)
+                    *captured = (uint32_t)(response >> 3);
+                return Ok;
+            }
+            if (ack != ACK_WAIT)
+                return ProtocolError;
+        }
+        return Wait;
+    }
+
+    // Test-Logic-Reset then Run-Test/Idle
+    void tap_reset()
+    {
+        for (uint8_t count = 0; count < 5; count++)
+            jtag_port::step(1, 0);
+        jtag_port::step(0, 0);
+        current_ir = IR_UNKNOWN;
+    }
+
+    // Run-Test/Idle to Run-Test/Idle, other TAPs get BYPASS
+    void scan_ir(uint8_t ir)
+    {
+        if (ir == current_ir)
+            return;
+        jtag_port::step(1, 0); // Select-DR
+        jtag_port::step(1, 0); // Select-IR
+        jtag_port::step(0, 0); // Capture-IR
+        jtag_port::step(0, 0); // Shift-IR
+        uint32_t length = ir_tdo_side + IR_LENGTH + ir_tdi_side;
+        for (uint32_t index = 0; index < length; index++) {
+            bool tdi = true;
+            if (index >= ir_tdo_side && index < (uint32_t)ir_tdo_side + IR_LENGTH)
+                tdi = (ir >> (index - ir_tdo_side)) & 1;
+            jtag_port::step(index == length - 1, tdi); // last bit to Exit1-IR
+        }
+        jtag_port::step(1, 0); // Update-IR
+        jtag_port::step(0, 0); // Run-Test/Idle
+        current_ir = ir;
+    }
+
+    // Run-Test/Idle to Run-Test/Idle, other TAPs are in BYPASS
+    uint64_t scan_dr(uint64_t value)
+    {
+        jtag_port::step(1, 0); // Select-DR
+        jtag_port::step(0, 0); // Capture-DR
+        jtag_port::step(0, 0); // Shift-DR
+        uint64_t captured = 0;
+        uint32_t length = dr_tdo_side + DR_LENGTH + dr_tdi_side;
+        for (uint32_t index = 0; index < length; index++) {
+            bool in_dap = index >= dr_tdo_side && index < (uint32_t)dr_tdo_side + DR_LENGTH;
+            bool tdi = in_dap ? (value >> (index - dr_tdo_side)) & 1 : false;
+            bool tdo = jtag_port::step(index == length - 1, tdi);
+            if (in_dap && tdo)
+                captured |= (uint64_t)1 << (index - dr_tdo_side);
+        }
+        jtag_port::step(1, 0); // Update-DR
+        jtag_port::step(0, 0); // Run-Test/Idle
+        return captured;
+    }
+
+    static uint32_t load_le32(const uint8_t *data)
+    {
+        return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    static void store_le32(uint8_t *data, uint32_t value)
+    {
+        data[0] = value;
+        data[1] = value >> 8;
+        data[2] = value >> 16;
+        data[3] = value >> 24;
+    }
+
+private:
+
+    uint8_t ir_tdo_side;
+    uint8_t ir_tdi_side;
+    uint8_t dr_tdo_side;
+    uint8_t dr_tdi_side;
+    uint8_t current_ir;
+    uint8_t present;
+};
+
+#endif
@@ -3,15 +3,34 @@
 
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
-
-#define SERIAL_TX_PIN 1
-#define SERIAL_RX_PIN 3
+#include "board.h"
 
 #define SERIAL_BAUD 115200
-#define SERIAL_BUFFER_SIZE 64
-#define SERIAL_INTERNAL_BUFFER_SIZE 2048
+#define SERIAL_BUFFER_SIZE 256
+#define SERIAL_INTERNAL_BUFFER_SIZE 2048 // at SERIAL_BAUD, scaled with baud
+#define SERIAL_INTERNAL_BUFFER_MIN  256
+#define SERIAL_INTERNAL_BUFFER_MAX  8192
+#define SERIAL_BAUD_MIN 300
+#define SERIAL_BAUD_MAX 4000000
 #define SERIAL_PORT 2222
 
+/* Framing byte, command port and internal
+ *  - bits 1:0 data bits - 5
+ *  - bits 3:2 parity, 0 none, 1 odd, 2 even
+ *  - bits 5:4 stop bits, 0 one, 1 one and half, 2 two
+ */
+#define SERIAL_FRAMING_8N1 0x03
+
+/* Stats index for SerialServer::get_stat
+ * 0 bytes target to client
+ * 1 bytes client to target
+ * 2 rx overruns
+ * 3 rx errors (framing / parity)
+ * 4 ms since current setting applied
+ * 5 average bytes/s target to client
+ * 6 rx buffer size
+ */
+
 // =============================================================================================
 class SerialPort
 {
@@ -20,26 +39,78 @@ public:
  
     static void begin()
     {
-        pinMode(SERIAL_TX_PIN, FUNCTION_0);
-        pinMode(SERIAL_RX_PIN, FUNCTION_0);
+        pinMode(Board::serial_tx_pin, FUNCTION_0);
+        pinMode(Board::serial_rx_pin, FUNCTION_0);
     }
 
     static void stop()
     {
         //GPIO 1 (TX) swap the pin to a GPIO.
-        pinMode(SERIAL_TX_PIN, FUNCTION_3);
+        pinMode(Board::serial_tx_pin, FUNCTION_3);
         //GPIO 3 (RX) swap the pin to a GPIO.
-        pinMode(SERIAL_RX_PIN, FUNCTION_3);
+        pinMode(Board::serial_rx_pin, FUNCTION_3);
         // Input for board serial 
-        pinMode(SERIAL_TX_PIN, INPUT_PULLUP);
-        pinMode(SERIAL_RX_PIN, INPUT_PULLUP);
+        pinMode(Board::serial_tx_pin, INPUT_PULLUP);
+        pinMode(Board::serial_rx_pin, INPUT_PULLUP);
     }
 };
 
 // =============================================================================================
 
+/* Raw TCP passthrough, or RFC 2217 (telnet COM port control) when the session starts with a telnet
+ * negotiation: IAC followed by WILL / WONT / DO / DONT / SB
+ *  - A raw session whose first two bytes happen to be such a pair is taken as telnet, 0xFF then gets
+ *    unescaped / escaped for the rest of the session
+ * https://www.rfc-editor.org/rfc/rfc2217
+ *  - Baud, data size, parity, stop size are applied to UART0
+ *  - Flow control always none: RTS / CTS of UART0 are taken by JTAG
+ *  - DTR / RTS / break not wired, always reported off, also when asked to set them
+ */
+
 class SerialServer
 {
+    // Telnet
+    static constexpr const uint8_t IAC  = 255;
+    static constexpr const uint8_t DONT = 254;
+    static constexpr const uint8_t DO   = 253;
+    static constexpr const uint8_t WONT = 252;
+    static constexpr const uint8_t WILL = 251;
+    static constexpr const uint8_t SB   = 250;
+    static constexpr const uint8_t SE   = 240;
+
+    static constexpr const uint8_t OPTION_BINARY   = 0;
+    static constexpr const uint8_t OPTION_ECHO     = 1;
+    static constexpr const uint8_t OPTION_SGA      = 3;
+    static constexpr const uint8_t OPTION_COM_PORT = 44;
+
+    // COM port sub commands, server replies with + 100
+    static constexpr const uint8_t COM_SIGNATURE     = 0;
+    static constexpr const uint8_t COM_SET_BAUDRATE  = 1;
+    static constexpr const uint8_t COM_SET_DATASIZE  = 2;
+    static constexpr const uint8_t COM_SET_PARITY    = 3;
+    static constexpr const uint8_t COM_SET_STOPSIZE  = 4;
+    static constexpr const uint8_t COM_SET_CONTROL   = 5;
+    static constexpr const uint8_t COM_PURGE_DATA    = 12;
+    static constexpr const uint8_t COM_SERVER_OFFSET = 100;
+
+    static constexpr const uint8_t SUB_BUFFER_SIZE = 8;
+
+    enum class TelnetState
+    {
+        Data,
+        Iac,
+        Option,
+        Sub,
+        SubIac,
+    };
+
+    enum class SessionState
+    {
+        New,
+        FirstIac,   // held until the next byte tells telnet from raw
+        Decided,
+    };
+
 public:
     SerialServer(uint16_t port) : server(port), client()
     {
@@ -47,15 +118,18 @@ public:
         SerialPort::stop();
         server.setNoDelay(true);
         running = 0;
+        baud = SERIAL_BAUD;
+        framing = SERIAL_FRAMING_8N1;
     }
 
     void begin()
     {
         if (!running) {
             SerialPort::begin();
-            Serial.begin(SERIAL_BAUD);
-            Serial.setRxBufferSize(SERIAL_INTERNAL_BUFFER_SIZE);
+            Serial.begin(baud, serial_config());
+            Serial.setRxBufferSize(rx_buffer_size());
             server.begin();
+            reset_stats();
             running = 1;
         }
     }
@@ -85,26 +159,51 @@ public:
             */
             // Need more processing power than previous impl but responsive
             if(!client.connected()) {
-                if (server.hasClient())
+                if (server.hasClient()) {
                     client = server.available();
+                    telnet = 0;
+                    session_state = SessionState::New;
+                    telnet_state = TelnetState::Data;
+                }
             } else {
                 while (client.available() && counter < SERIAL_BUFFER_SIZE) {
                     // data should be availabe so skip -1 check.
                     // more data than SERIAL_BUFFER_SIZE? next time.
-                    buffer[counter++] = (uint8_t)client.read();
+                    uint8_t data = (uint8_t)client.read();
+                    if (session_state == SessionState::New && data == IAC) {
+                        session_state = SessionState::FirstIac;
+                        continue;
+                    }
+                    if (session_state == SessionState::FirstIac) {
+                        telnet = data >= SB && data != IAC;
+                        if (telnet)
+                            telnet_input(IAC);
+                        else
+                            buffer[counter++] = IAC;
+                    }
+                    session_state = SessionState::Decided;
+                    if (!telnet || telnet_input(data))
+                        buffer[counter++] = data;
                 }
                 // Client to serial
-                Serial.write(buffer, counter);
-                counter = 0;
+                write_serial();
 
                 // Serial to client
                 while(Serial.available() && counter < SERIAL_BUFFER_SIZE){
                     buffer[counter] = (uint8_t)Serial.read();
                     counter++;
                 }
-                client.write(buffer, counter);
+                if (telnet)
+                    write_escaped(buffer, counter);
+                else
+                    client.write(buffer, counter);
+                stats_rx += counter;
                 counter = 0;
             }
+            if (Serial.hasOverrun())
+                stats_overrun++;
+            if (Serial.hasRxError())
+                stats_rx_error++;
         }
     }
 
@@ -113,6 +212,264 @@ public:
         return running;
     }
 
+    // Returns baud in use, unchanged when out of range
+    uint32_t set_baud(uint32_t value)
+    {
+        if (value >= SERIAL_BAUD_MIN && value <= SERIAL_BAUD_MAX && value != baud) {
+            baud = value;
+            if (running) {
+                // Bytes already queued still go out with the old setting
+                Serial.flush();
+                Serial.updateBaudRate(baud);
+                Serial.setRxBufferSize(rx_buffer_size());
+                reset_stats();
+            }
+        }
+        return baud;
+    }
+
+    uint32_t get_baud()
+    {
+        return baud;
+    }
+
+    // Returns framing in use, unchanged when invalid
+    uint8_t set_framing(uint8_t value)
+    {
+        if (((value >> 2) & 3) != 3 && ((value >> 4) & 3) != 3 && (value >> 6) == 0 && value != framing) {
+            framing = value;
+            if (running) {
+                Serial.flush();
+                Serial.end();
+                Serial.begin(baud, serial_config());
+                Serial.setRxBufferSize(rx_buffer_size());
+                reset_stats();
+            }
+        }
+        return framing;
+    }
+
+    uint8_t get_framing()
+    {
+        return framing;
+    }
+
+    uint32_t get_stat(uint8_t index)
+    {
+        uint32_t elapsed = millis() - stats_started;
+        switch (index) {
+            case 0:
+                return stats_rx;
+            case 1:
+                return stats_tx;
+            case 2:
+                return stats_overrun;
+            case 3:
+                return stats_rx_error;
+            case 4:
+                return elapsed;
+            case 5:
+                return elapsed ? (uint32_t)((uint64_t)stats_rx * 1000 / elapsed) : 0;
+            case 6:
+                return rx_buffer_size();
+            default:
+                return 0;
+        }
+    }
+
+private:
+
+    // Same time worth of data as SERIAL_INTERNAL_BUFFER_SIZE at SERIAL_BAUD
+    size_t rx_buffer_size()
+    {
+        uint32_t size = (uint64_t)SERIAL_INTERNAL_BUFFER_SIZE * baud / SERIAL_BAUD;
+        if (size < SERIAL_INTERNAL_BUFFER_MIN)
+            return SERIAL_INTERNAL_BUFFER_MIN;
+        if (size > SERIAL_INTERNAL_BUFFER_MAX)
+            return SERIAL_INTERNAL_BUFFER_MAX;
+        return size;
+    }
+
+    SerialConfig serial_config()
+    {
+        static const uint8_t data_bits[4] = {UART_NB_BIT_5, UART_NB_BIT_6, UART_NB_BIT_7, UART_NB_BIT_8};
+        static const uint8_t parity[3] = {UART_PARITY_NONE, UART_PARITY_ODD, UART_PARITY_EVEN};
+        static const uint8_t stop_bits[3] = {UART_NB_STOP_BIT_1, UART_NB_STOP_BIT_15, UART_NB_STOP_BIT_2};
+        return (SerialConfig)(data_bits[framing & 3] | parity[(framing >> 2) & 3] | stop_bits[(framing >> 4) & 3]);
+    }
+
+    void write_serial()
+    {
+        Serial.write(buffer, counter);
+        stats_tx += counter;
+        counter = 0;
+    }
+
+    void reset_stats()
+    {
+        stats_rx = 0;
+        stats_tx = 0;
+        stats_overrun = 0;
+        stats_rx_error = 0;
+        stats_started = millis();
+    }
+
+    // Returns true when data is a payload byte
+    bool telnet_input(uint8_t data)
+    {
+        switch (telnet_state) {
+            case TelnetState::Data:
+                if (data != IAC)
+                    return true;
+                telnet_state = TelnetState::Iac;
+                break;
+            case TelnetState::Iac:
+                telnet_state = TelnetState::Data;
+                if (data == IAC) {
+                    return true;
+                } else if (data >= WILL) {
+                    telnet_verb = data;
+                    telnet_state = TelnetState::Option;
+                } else if (data == SB) {
+                    sub_length = 0;
+                    telnet_state = TelnetState::Sub;
+                }
+                break;
+            case TelnetState::Option:
+                telnet_option(telnet_verb, data);
+                telnet_state = TelnetState::Data;
+                break;
+            case TelnetState::Sub:
+                if (data == IAC)
+                    telnet_state = TelnetState::SubIac;
+                else if (sub_length < SUB_BUFFER_SIZE)
+                    sub_buffer[sub_length++] = data;
+                break;
+            case TelnetState::SubIac:
+                if (data == SE) {
+                    telnet_state = TelnetState::Data;
+                    if (sub_length >= 2 && sub_buffer[0] == OPTION_COM_PORT)
+                        com_port_command(sub_buffer[1], sub_buffer + 2, sub_length - 2);
+                } else {
+                    if (sub_length < SUB_BUFFER_SIZE)
+                        sub_buffer[sub_length++] = data;
+                    telnet_state = TelnetState::Sub;
+                }
+                break;
+        }
+        return false;
+    }
+
+    // No echo is done, serial target echoes itself
+    void telnet_option(uint8_t verb, uint8_t option)
+    {
+        bool supported = option == OPTION_BINARY || option == OPTION_SGA || option == OPTION_COM_PORT;
+        uint8_t reply[3] = {IAC, 0, option};
+        if (verb == WILL)
+            reply[1] = supported ? DO : DONT;
+        else if (verb == DO)
+            reply[1] = (supported || option == OPTION_ECHO) ? WILL : WONT;
+        else
+            return;
+        client.write(reply, 3);
+    }
+
+    void com_port_command(uint8_t command, const uint8_t *value, uint8_t length)
+    {
+        // Payload read before this command in the same batch goes out with the current setting
+        write_serial();
+        uint8_t reply[4] = {0};
+        uint8_t reply_length = 1;
+        uint8_t request = length ? value[0] : 0;
+        switch (command) {
+            case COM_SIGNATURE:
+                send_com_port(command, (const uint8_t *)"ESP8266 XVC-Serial bridge", 25);
+                return;
+            case COM_SET_BAUDRATE: {
+                uint32_t requested = 0;
+                if (length >= 4)
+                    requested = ((uint32_t)value[0] << 24) | ((uint32_t)value[1] << 16) | ((uint32_t)value[2] << 8) | value[3];
+                if (requested)
+                    set_baud(requested);
+                reply[0] = baud >> 24;
+                reply[1] = baud >> 16;
+                reply[2] = baud >> 8;
+                reply[3] = baud;
+                reply_length = 4;
+                break;
+            }
+            case COM_SET_DATASIZE:
+                if (request >= 5 && request <= 8)
+                    set_framing((framing & ~0x03) | (request - 5));
+                reply[0] = (framing & 3) + 5;
+                break;
+            case COM_SET_PARITY: {
+                // RFC 1 none, 2 odd, 3 even, mark / space not supported
+                if (request >= 1 && request <= 3)
+                    set_framing((framing & ~0x0C) | ((request - 1) << 2));
+                reply[0] = ((framing >> 2) & 3) + 1;
+                break;
+            }
+            case COM_SET_STOPSIZE: {
+                // RFC 1 one, 2 two, 3 one and half
+                static const uint8_t to_framing[4] = {0, 0, 2, 1};
+                static const uint8_t to_rfc[3] = {1, 3, 2};
+                if (request >= 1 && request <= 3)
+                    set_framing((framing & ~0x30) | (to_framing[request] << 4));
+                reply[0] = to_rfc[(framing >> 4) & 3];
+                break;
+            }
+            case COM_SET_CONTROL:
+                // Report actual state, not the requested one
+                if (request <= 3 || request == 17 || request == 19)
+                    reply[0] = 1;   // outbound flow control none
+                else if (request <= 6)
+                    reply[0] = 6;   // break off
+                else if (request <= 9)
+                    reply[0] = 9;   // DTR off
+                else if (request <= 12)
+                    reply[0] = 12;  // RTS off
+                else if (request <= 16 || request == 18)
+                    reply[0] = 14;  // inbound flow control none
+                else
+                    reply[0] = request;
+                break;
+            case COM_PURGE_DATA:
+                if (request & 1)
+                    while (Serial.available())
+                        Serial.read();
+                reply[0] = request;
+                break;
+            default:
+                // Line / modem state notifications are not generated, acknowledge with empty masks
+                reply[0] = 0;
+                break;
+        }
+        send_com_port(command, reply, reply_length);
+    }
+
+    void send_com_port(uint8_t command, const uint8_t *value, uint8_t length)
+    {
+        uint8_t header[4] = {IAC, SB, OPTION_COM_PORT, (uint8_t)(command + COM_SERVER_OFFSET)};
+        client.write(header, 4);
+        write_escaped(value, length);
+        uint8_t footer[2] = {IAC, SE};
+        client.write(footer, 2);
+    }
+
+    // IAC in payload is sent twice
+    void write_escaped(const uint8_t *data, size_t length)
+    {
+        size_t start = 0;
+        for (size_t index = 0; index < length; index++) {
+            if (data[index] == IAC) {
+                client.write(data + start, index - start + 1);
+                start = index;
+            }
+        }
+        client.write(data + start, length - start);
+    }
+
 private:
     uint8_t running;
     WiFiServer server;
@@ -120,6 +477,22 @@ private:
     
     uint32_t counter;
     uint8_t buffer[SERIAL_BUFFER_SIZE];
+
+    uint32_t baud;
+    uint8_t framing;
+
+    uint8_t telnet;
+    SessionState session_state;
+    TelnetState telnet_state;
+    uint8_t telnet_verb;
+    uint8_t sub_buffer[SUB_BUFFER_SIZE];
+    uint8_t sub_length;
+
+    uint32_t stats_rx;
+    uint32_t stats_tx;
+    uint32_t stats_overrun;
+    uint32_t stats_rx_error;
+    uint32_t stats_started;
 };
 
 #endif
@@ -1,6 +1,6 @@
 #include "command.h"
 
-CommandServer<CommandPort<COMMAND_RST_PIN, COMMAND_BOOTMODE_CONTROL_PIN, COMMAND_BOOTMODE_SELECTOR_PIN>> command_server(COMMAND_PORT);
+CommandServer<CommandPort<Board>> command_server(COMMAND_PORT);
 
 void setup()
 {
@@ -3,12 +3,11 @@
 
 #include <Arduino.h>
 #include <ESP8266WiFi.h>
+#include "dap.h"
+#include "chain.h"
 
 #define XVC_PORT 2542
-#define XVC_TMS  4
-#define XVC_TCK  14
-#define XVC_TDO  12
-#define XVC_TDI  13
+#define XVC_CHAIN_RESCAN_DELAY 500 // ms, target reset supervisor holds a while after release
 
 // =============================================================================================
 
@@ -72,6 +71,11 @@ public:
             }
         }
         *buffer = tdo_byte;
+        tck_low();
+    }
+
+    static void tck_low()
+    {
         GPOC = tck_pin_mask;
     }
 
@@ -84,6 +88,19 @@ private:
 
 // =============================================================================================
 
+/* XVC 1.1, https://github.com/Xilinx/XilinxVirtualCable
+ *  - getinfo:, settck:, shift: as 1.0
+ *  - mrd:<flags 4><addr 4><num_bytes 4>
+ *      => num_bytes of data then 1 status byte, data is zero on failure
+ *  - mwr:<flags 4><addr 4><num_bytes 4><data num_bytes>
+ *      => 1 status byte
+ *  - chain:
+ *      => 1 byte device count, then per device 4 bytes IDCODE + 1 byte IR length, TDO side first
+ *         count 0 when discovery failed, IR length 0 when unresolved
+ * Memory access goes through the ARM DAP MEM-AP, words only, integers little endian
+ * Flags reserved, status is JtagDap::Status, 0 on success
+ */
+
 template <typename jtag_port>
 class XvcServer
 {
@@ -94,6 +111,10 @@ class XvcServer
         SetClockCommand,
         ShiftCommand,
         ShiftData,
+        MemReadCommand,
+        MemWriteCommand,
+        MemWriteData,
+        ChainCommand,
     };
 
 public:
@@ -111,6 +132,7 @@ public:
             jtag_port::begin();
             server.begin();
             running = 1;
+            discover_chain();
         }
     }
 
@@ -122,6 +144,9 @@ public:
             server.stop();
             jtag_port::stop();
             running = 0;
+            // JTAG is high-Z, nothing to report until the next begin
+            chain.invalidate();
+            rescan_pending = 0;
         }
     }
 
@@ -130,9 +155,55 @@ public:
         return running;
     }
 
+    /* Cached result, also points the DAP at the discovered position
+     * Chain scanned but no resolved DAP => mrd / mwr fail with NoDap instead of using a stale position
+     * Scan failed => Zynq-7000 default position
+     */
+    void discover_chain()
+    {
+        rescan_pending = 0;
+        if (!running) {
+            chain.invalidate();
+            return;
+        }
+        chain.discover();
+        uint8_t ir_tdo, ir_tdi, dr_tdo, dr_tdi;
+        if (chain.find_dap(ir_tdo, ir_tdi, dr_tdo, dr_tdi))
+            dap.set_chain(ir_tdo, ir_tdi, dr_tdo, dr_tdi);
+        else if (chain.is_valid())
+            dap.set_absent();
+        else
+            dap.set_default_chain();
+    }
+
+    /* Discovery forces Test-Logic-Reset, run from the loop only while no client is connected
+     * so a client session survives. Previous result stays cached until then.
+     * After reset_board the target is held in reset for a while => delay
+     */
+    void schedule_chain_discovery(uint32_t delay_ms)
+    {
+        if (!running)
+            return;
+        rescan_pending = 1;
+        rescan_at = millis() + delay_ms;
+    }
+
+    uint8_t is_chain_discovery_pending()
+    {
+        return rescan_pending;
+    }
+
+    // Cached only, never scans
+    const JtagChain<jtag_port> &get_chain()
+    {
+        return chain;
+    }
+
     void handle()
     {
         if (running) {
+            if (rescan_pending && !client.connected() && (int32_t)(millis() - rescan_at) >= 0)
+                discover_chain();
             if (client.connected()) {
                 if (client.available()) {
                     size_t len = client.read(buffer + position, remaining);
@@ -180,6 +251,18 @@ private:
             remaining = 8;
             state = ProtocolState::ShiftCommand;
         }
+        else if (memcmp(buffer, "mr", 2) == 0) {
+            remaining = 14;
+            state = ProtocolState::MemReadCommand;
+        }
+        else if (memcmp(buffer, "mw", 2) == 0) {
+            remaining = 14;
+            state = ProtocolState::MemWriteCommand;
+        }
+        else if (memcmp(buffer, "ch", 2) == 0) {
+            remaining = 4;
+            state = ProtocolState::ChainCommand;
+        }
         else {
             enter_error_state();
         }
@@ -192,7 +275,7 @@ private:
             parse_command();
             break;
         case ProtocolState::GetInfoCommand:
-            client.printf("xvcServer_v1.0:%u\n", max_buffer_size);
+            client.printf("xvcServer_v1.1:%u\n", max_buffer_size);
             enter_waiting_command();
             break;
         case ProtocolState::SetClockCommand:
@@ -205,7 +288,8 @@ private:
             bit_len = (bit_len << 8) | buffer[5];
             bit_len = (bit_len << 8) | buffer[4];
             byte_len = (bit_len + 7) / 8;
-            if (byte_len <= max_buffer_size) {
+            // TMS and TDI vectors both go into buffer
+            if (byte_len * 2 <= max_buffer_size) {
                 state = ProtocolState::ShiftData;
                 remaining = byte_len * 2;
                 position = 0;
@@ -219,16 +303,89 @@ private:
             client.write(buffer, byte_len);
             enter_waiting_command();
             break;
+        case ProtocolState::MemReadCommand:
+            if (!parse_mem_command("d:")) {
+                enter_error_state();
+                break;
+            }
+            mem_status = dap.read(mem_address, mem_len / 4, buffer);
+            // Words before the failure are already in, do not hand out partial data
+            if (mem_status != JtagDap<jtag_port>::Ok)
+                memset(buffer, 0, mem_len);
+            client.write(buffer, mem_len);
+            client.write(&mem_status, 1);
+            enter_waiting_command();
+            break;
+        case ProtocolState::MemWriteCommand:
+            if (!parse_mem_command("r:")) {
+                enter_error_state();
+                break;
+            }
+            state = ProtocolState::MemWriteData;
+            remaining = mem_len;
+            position = 0;
+            if (remaining == 0)
+                next_state();
+            break;
+        case ProtocolState::MemWriteData:
+            mem_status = dap.write(mem_address, mem_len / 4, buffer);
+            client.write(&mem_status, 1);
+            enter_waiting_command();
+            break;
+        case ProtocolState::ChainCommand:
+            if (memcmp(buffer, "ain:", 4) != 0) {
+                enter_error_state();
+                break;
+            }
+            respond_chain();
+            enter_waiting_command();
+            break;
         default:
             enter_error_state();
             break;
         }
     }
 
+    // Rest of "mrd:" / "mwr:" header, length must fit the buffer and be whole words
+    bool parse_mem_command(const char *suffix)
+    {
+        if (memcmp(buffer, suffix, 2) != 0)
+            return false;
+        mem_address = read_le32(buffer + 6);
+        mem_len = read_le32(buffer + 10);
+        return mem_len <= max_buffer_size && (mem_len & 3) == 0;
+    }
+
+    void respond_chain()
+    {
+        const JtagChain<jtag_port> &cached = get_chain();
+        uint8_t count = cached.device_count();
+        buffer[0] = count;
+        for (uint8_t index = 0; index < count; index++) {
+            uint32_t idcode = cached.idcode(index);
+            uint8_t *entry = buffer + 1 + index * 5;
+            entry[0] = idcode;
+            entry[1] = idcode >> 8;
+            entry[2] = idcode >> 16;
+            entry[3] = idcode >> 24;
+            entry[4] = cached.ir_length(index);
+        }
+        client.write(buffer, 1 + count * 5);
+    }
+
+    static uint32_t read_le32(const uint8_t *data)
+    {
+        return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
 private:
 
     WiFiServer server;
     WiFiClient client;
+    JtagDap<jtag_port> dap;
+    JtagChain<jtag_port> chain;
+    uint8_t rescan_pending = 0;
+    uint32_t rescan_at;
 
     ProtocolState state;
     size_t remaining;
@@ -237,6 +394,10 @@ private:
     uint32_t bit_len;
     uint32_t byte_len;
 
+    uint32_t mem_address;
+    uint32_t mem_len;
+    uint8_t mem_status;
+
     static constexpr size_t max_buffer_size = 16 * 1024;
     uint8_t buffer[max_buffer_size];
 
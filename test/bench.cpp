@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "test.h"
+#include "jtag_model.h"
+#include "command.h"
+
+/* Host benchmark of the whole firmware main loop, see README
+ *  - CommandServer / XvcServer / SerialServer / JtagPort as built for the board, one handle() per pump
+ *  - JTAG pins drive the host model through the GPIO register stub, UART0 echoes what it is sent
+ *  - Clients talk over loopback sockets from the same thread, waiting always pumps the loop
+ * Work counts (GPIO writes per TCK, TCK per DAP word) are checked on every run, times only against
+ * a baseline: -o file saves one, -b file compares, -t sets the allowed regression ratio
+ */
+
+CommandServer<CommandPort<Board>> command_server(COMMAND_PORT);
+
+#define BENCH_TIMEOUT_MS 5000
+#define BENCH_THRESHOLD  0.25   // loopback timing is steadier than Wi-Fi, not steady enough for 10%
+#define BENCH_REPEATS    3      // best of these is kept, one scheduler hiccup does not count
+
+// Every JtagPort::step is GPOC, GPOS, GPOS, shift adds one GPOC for TCK low
+#define MAX_GPIO_WRITES_PER_TCK 3
+// Same bound as test_dap
+#define MAX_TCK_PER_WORD 45
+
+static const uint32_t XVC_SHIFT_BITS[] = {32, 256, 2048, 16384, 65536};
+
+typedef std::chrono::steady_clock Clock;
+
+struct Metric
+{
+    double value;
+    bool higher_is_better;
+};
+
+static std::map<std::string, Metric> metrics;
+
+static double seconds_since(Clock::time_point started)
+{
+    return std::chrono::duration<double>(Clock::now() - started).count();
+}
+
+static double percentile(std::vector<double> samples, double p)
+{
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, (size_t)(samples.size() * p))];
+}
+
+static void keep_best(const std::string &name, double value, bool higher_is_better)
+{
+    auto found = metrics.find(name);
+    if (found == metrics.end() || (higher_is_better ? value > found->second.value : value < found->second.value))
+        metrics[name] = {value, higher_is_better};
+}
+
+static void add_latency(const std::string &prefix, const std::vector<double> &samples)
+{
+    keep_best(prefix + "_p50_us", percentile(samples, 0.50) * 1e6, false);
+    keep_best(prefix + "_p95_us", percentile(samples, 0.95) * 1e6, false);
+}
+
+// =============================================================================================
+// Client side, every wait runs the firmware loop
+
+static void pump()
+{
+    command_server.handle();
+}
+
+static int connect_to(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port + host_port_offset());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(2);
+    }
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    return fd;
+}
+
+static void send_all(int fd, const void *data, size_t length)
+{
+    if (send(fd, data, length, MSG_NOSIGNAL) != (ssize_t)length) {
+        perror("send");
+        exit(2);
+    }
+}
+
+static bool recv_exact(int fd, void *data, size_t length)
+{
+    Clock::time_point started = Clock::now();
+    size_t received = 0;
+    while (received < length) {
+        ssize_t count = recv(fd, (uint8_t *)data + received, length - received, MSG_DONTWAIT);
+        if (count > 0)
+            received += count;
+        else if (count == 0 || seconds_since(started) * 1000 > BENCH_TIMEOUT_MS)
+            return false;
+        else
+            pump();
+    }
+    return true;
+}
+
+static bool command(int fd, uint8_t code, int data, uint32_t &value)
+{
+    uint8_t request[5] = {0x04, 0x20, 0x69, code, (uint8_t)data};
+    send_all(fd, request, data < 0 ? 4 : 5);
+    uint8_t reply[9];
+    if (!recv_exact(fd, reply, sizeof(reply)) || memcmp(reply, request, 4) != 0)
+        return false;
+    memcpy(&value, reply + 5, 4);
+    return true;
+}
+
+static bool xvc_shift(int fd, uint32_t bits, std::vector<uint8_t> &vectors)
+{
+    uint32_t bytes = (bits + 7) / 8;
+    uint8_t header[10] = {'s', 'h', 'i', 'f', 't', ':', (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+    send_all(fd, header, sizeof(header));
+    send_all(fd, vectors.data(), bytes * 2);
+    return recv_exact(fd, vectors.data(), bytes);
+}
+
+static void put_le32(uint8_t *data, uint32_t value)
+{
+    for (uint8_t index = 0; index < 4; index++)
+        data[index] = value >> (index * 8);
+}
+
+// =============================================================================================
+
+static JtagModel &reset_model()
+{
+    JtagModel &model = JtagModel::instance();
+    model.reset({
+        {6, 0x11, 0x03722093, 0x09, false}, // Zynq-7010 PL
+        {4, 0x01, 0x4BA00477, 0x0E, true},  // ARM DAP
+    });
+    return model;
+}
+
+static void bench_command(int fd)
+{
+    uint32_t value;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        std::vector<double> samples;
+        for (int round = 0; round < 1000; round++) {
+            Clock::time_point started = Clock::now();
+            CHECK(command(fd, 1, -1, value));
+            samples.push_back(seconds_since(started));
+        }
+        add_latency("command_rtt", samples);
+    }
+}
+
+static void bench_udp()
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(COMMAND_PORT + host_port_offset());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    uint16_t sequence = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        std::vector<double> samples;
+        for (int round = 0; round < 1000; round++, sequence++) {
+            // New sequence every round, the reply cache must not answer
+            uint8_t request[6] = {0x04, 0x20, 0x69, (uint8_t)sequence, (uint8_t)(sequence >> 8), 1};
+            Clock::time_point started = Clock::now();
+            sendto(fd, request, sizeof(request), 0, (sockaddr *)&address, sizeof(address));
+            uint8_t reply[COMMAND_UDP_REPLY_SIZE];
+            ssize_t length = -1;
+            while (length < 0 && seconds_since(started) * 1000 < BENCH_TIMEOUT_MS) {
+                pump();
+                length = recv(fd, reply, sizeof(reply), MSG_DONTWAIT);
+            }
+            CHECK(length == 11 && memcmp(reply, request, 6) == 0);
+            samples.push_back(seconds_since(started));
+        }
+        add_latency("udp_rtt", samples);
+    }
+    close(fd);
+}
+
+static void bench_xvc_shift(int fd)
+{
+    JtagModel &model = JtagModel::instance();
+    HostGpio &gpio = HostGpio::instance();
+    for (uint32_t bits : XVC_SHIFT_BITS) {
+        uint32_t bytes = (bits + 7) / 8;
+        // TMS low, TDI pattern, TAP stays in Run-Test/Idle
+        std::vector<uint8_t> vectors(bytes * 2);
+        uint32_t rounds = std::max<uint32_t>(8, (1UL << 20) / bits);
+        double best = 0;
+        for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+            uint64_t tck_before = model.tck;
+            uint64_t writes_before = gpio.writes;
+            Clock::time_point started = Clock::now();
+            for (uint32_t round = 0; round < rounds; round++) {
+                std::fill(vectors.begin(), vectors.begin() + bytes, 0);
+                std::fill(vectors.begin() + bytes, vectors.end(), 0xA5);
+                CHECK(xvc_shift(fd, bits, vectors));
+            }
+            best = std::max(best, bits * rounds / seconds_since(started) / 1000);
+            CHECK_EQUAL(model.tck - tck_before, (uint64_t)bits * rounds);
+            CHECK(gpio.writes - writes_before <= (uint64_t)(MAX_GPIO_WRITES_PER_TCK * bits + 1) * rounds);
+        }
+        metrics["xvc_shift_" + std::to_string(bits) + "_kbit_s"] = {best, true};
+    }
+}
+
+static void bench_xvc_memory(int fd)
+{
+    const uint32_t words = 4096;
+    const uint32_t address = 0x00100000;
+    JtagModel &model = JtagModel::instance();
+    for (uint32_t index = 0; index < words; index++)
+        model.memory[address + index * 4] = address + index * 4;
+    uint8_t request[16] = {'m', 'r', 'd', ':'};
+    put_le32(request + 8, address);
+    put_le32(request + 12, words * 4);
+    std::vector<uint8_t> reply(words * 4 + 1);
+    double best = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        uint64_t tck_before = model.tck;
+        Clock::time_point started = Clock::now();
+        send_all(fd, request, sizeof(request));
+        CHECK(recv_exact(fd, reply.data(), reply.size()));
+        best = std::max(best, words / seconds_since(started));
+        CHECK_EQUAL(reply[words * 4], 0);
+        CHECK_EQUAL(reply[(words - 1) * 4 + 1] | (reply[(words - 1) * 4 + 2] << 8), (address + (words - 1) * 4) >> 8);
+        double tck_per_word = (double)(model.tck - tck_before) / words;
+        CHECK(tck_per_word < MAX_TCK_PER_WORD);
+        keep_best("xvc_mrd_tck_per_word", tck_per_word, false);
+    }
+    metrics["xvc_mrd_words_s"] = {best, true};
+}
+
+static void bench_serial(int fd)
+{
+    const size_t total = 1 << 20;
+    const size_t chunk = 4096;
+    // Below 0xFA, a leading IAC pair would switch the session to telnet
+    std::vector<uint8_t> sending(chunk);
+    for (size_t index = 0; index < chunk; index++)
+        sending[index] = index % 0xF0;
+    std::vector<uint8_t> received(chunk);
+    double best = 0;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        size_t sent = 0;
+        size_t echoed = 0;
+        bool matches = true;
+        Clock::time_point started = Clock::now();
+        while (echoed < total && seconds_since(started) * 1000 < BENCH_TIMEOUT_MS) {
+            if (sent < total && sent - echoed < 4 * chunk) {
+                send_all(fd, sending.data(), chunk);
+                sent += chunk;
+            }
+            pump();
+            ssize_t count = recv(fd, received.data(), chunk, MSG_DONTWAIT);
+            for (ssize_t index = 0; index < count; index++)
+                matches = matches && received[index] == sending[(echoed + index) % chunk];
+            if (count > 0)
+                echoed += count;
+        }
+        CHECK_EQUAL(echoed, total);
+        CHECK(matches);
+        best = std::max(best, (sent + echoed) / seconds_since(started));
+    }
+    metrics["serial_duplex_bytes_s"] = {best, true};
+}
+
+// Command waits behind whatever the other servers do in the same loop pass, XVC kept busy
+static void bench_loaded(int command_fd, int xvc_fd)
+{
+    const uint32_t bits = 65536;
+    const size_t reply_bytes = bits / 8;
+    std::vector<uint8_t> vectors(reply_bytes * 2);
+    uint8_t header[10] = {'s', 'h', 'i', 'f', 't', ':', (uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+    std::vector<uint8_t> drained(reply_bytes);
+    size_t outstanding = 0;
+    uint32_t value;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        std::vector<double> samples;
+        for (int round = 0; round < 300; round++) {
+            while (outstanding < 2 * reply_bytes) {
+                send_all(xvc_fd, header, sizeof(header));
+                send_all(xvc_fd, vectors.data(), vectors.size());
+                outstanding += reply_bytes;
+            }
+            Clock::time_point started = Clock::now();
+            CHECK(command(command_fd, 1, -1, value));
+            samples.push_back(seconds_since(started));
+            ssize_t count = recv(xvc_fd, drained.data(), std::min(drained.size(), outstanding), MSG_DONTWAIT);
+            if (count > 0)
+                outstanding -= count;
+        }
+        add_latency("command_rtt_loaded", samples);
+    }
+    while (outstanding > 0) {
+        size_t length = std::min(drained.size(), outstanding);
+        CHECK(recv_exact(xvc_fd, drained.data(), length));
+        outstanding -= length;
+    }
+}
+
+// =============================================================================================
+// Baseline file, one "name value higher|lower" per line
+
+static bool save(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file)
+        return false;
+    for (const auto &entry : metrics)
+        fprintf(file, "%s %.6g %s\n", entry.first.c_str(), entry.second.value, entry.second.higher_is_better ? "higher" : "lower");
+    return fclose(file) == 0;
+}
+
+// Returns regressions, a baseline metric that is not measured any more counts as one
+static int compare(const char *path, double threshold)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        printf("cannot read baseline %s\n", path);
+        return 1;
+    }
+    int regressions = 0;
+    char name[128];
+    double baseline;
+    char better[16];
+    while (fscanf(file, "%127s %lf %15s", name, &baseline, better) == 3) {
+        auto found = metrics.find(name);
+        if (found == metrics.end()) {
+            printf("REGRESSION %s missing\n", name);
+            regressions++;
+            continue;
+        }
+        double change = baseline != 0 ? (found->second.value - baseline) / baseline : 0;
+        bool worse = strcmp(better, "higher") == 0 ? change < -threshold : change > threshold;
+        if (worse) {
+            printf("REGRESSION %s %.6g -> %.6g (%+.0f%%)\n", name, baseline, found->second.value, change * 100);
+            regressions++;
+        }
+    }
+    fclose(file);
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = nullptr;
+    const char *baseline = nullptr;
+    double threshold = BENCH_THRESHOLD;
+    for (int index = 1; index + 1 < argc; index += 2) {
+        if (strcmp(argv[index], "-o") == 0)
+            output = argv[index + 1];
+        else if (strcmp(argv[index], "-b") == 0)
+            baseline = argv[index + 1];
+        else if (strcmp(argv[index], "-t") == 0)
+            threshold = atof(argv[index + 1]);
+    }
+
+    // Bootmode button released, pulled up
+    HostGpio::instance().input |= 1UL << Board::bootmode_selector_pin;
+    HostGpio::instance().attach_jtag(Board::tck_pin, Board::tdo_pin, Board::tdi_pin, Board::tms_pin, ModelPort::step);
+    reset_model();
+    command_server.setup();
+    Serial.echo = true;
+
+    int command_fd = connect_to(COMMAND_PORT);
+    uint32_t value = 0;
+    CHECK(command(command_fd, 3, 1, value) && value == 1);
+    CHECK(command(command_fd, 5, 1, value) && value == 1);
+    CHECK(command(command_fd, 9, -1, value) && value == 2);
+
+    int xvc_fd = connect_to(XVC_PORT);
+    send_all(xvc_fd, "getinfo:", 8);
+    char info[32] = {0};
+    CHECK(recv_exact(xvc_fd, info, strlen("xvcServer_v1.1:16384\n")));
+    CHECK(strcmp(info, "xvcServer_v1.1:16384\n") == 0);
+    // Test-Logic-Reset then Run-Test/Idle
+    std::vector<uint8_t> reset_vectors = {0x1f, 0x00};
+    CHECK(xvc_shift(xvc_fd, 6, reset_vectors));
+
+    int serial_fd = connect_to(SERIAL_PORT);
+
+    bench_command(command_fd);
+    bench_udp();
+    bench_xvc_shift(xvc_fd);
+    bench_xvc_memory(xvc_fd);
+    bench_serial(serial_fd);
+    bench_loaded(command_fd, xvc_fd);
+
+    close(serial_fd);
+    close(xvc_fd);
+    close(command_fd);
+
+    for (const auto &entry : metrics)
+        printf("%-32s %12.6g %s\n", entry.first.c_str(), entry.second.value, entry.second.higher_is_better ? "higher" : "lower");
+    if (output && !save(output)) {
+        printf("cannot write %s\n", output);
+        test_failures++;
+    }
+    if (baseline) {
+        int regressions = compare(baseline, threshold);
+        if (regressions)
+            printf("%d regression(s) over %.0f%%\n", regressions, threshold * 100);
+        else
+            printf("No regression over %.0f%%\n", threshold * 100);
+        test_failures += regressions;
+    }
+    return test_result();
+}
@@ -0,0 +1,321 @@
+#ifndef JTAG_MODEL_H
+#define JTAG_MODEL_H
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+// =============================================================================================
+// Host model of a JTAG scan chain, stands in for JtagPort in server/ headers
+//  - IEEE 1149.1 TAP state machine, all devices share TMS
+//  - IDCODE / BYPASS after Test-Logic-Reset, "...01" IR capture patterns
+//  - One ADIv5 JTAG-DP with a MEM-AP over sparse memory, TAR auto increment wraps at 1KB
+//  - Injected WAIT responses and STICKYERR address range
+// Device 0 is the one closest to TDO, same order as JtagChain
+
+struct ModelDevice
+{
+    uint8_t ir_length;
+    uint32_t ir_capture;    // loaded in Capture-IR
+    uint32_t idcode;        // 0 => BYPASS only
+    uint32_t idcode_ir;     // instruction after Test-Logic-Reset
+    bool dap;               // JTAG-DP, DPACC / APACC instructions
+};
+
+class JtagModel
+{
+public:
+
+    enum State
+    {
+        TestLogicReset, RunTestIdle,
+        SelectDr, CaptureDr, ShiftDr, Exit1Dr, PauseDr, Exit2Dr, UpdateDr,
+        SelectIr, CaptureIr, ShiftIr, Exit1Ir, PauseIr, Exit2Ir, UpdateIr,
+    };
+
+    static constexpr const uint32_t IR_DPACC = 0xA;
+    static constexpr const uint32_t IR_APACC = 0xB;
+
+    static constexpr const uint8_t ACK_WAIT = 0x1;
+    static constexpr const uint8_t ACK_OK   = 0x2;
+
+    static constexpr const uint32_t CTRL_POWER_REQ = (1UL << 30) | (1UL << 28);
+    static constexpr const uint32_t CTRL_STICKY    = (1UL << 5) | (1UL << 4) | (1UL << 1);
+    static constexpr const uint32_t CTRL_STICKYERR = (1UL << 5);
+
+    static JtagModel &instance()
+    {
+        static JtagModel model;
+        return model;
+    }
+
+    void reset(const std::vector<ModelDevice> &chain)
+    {
+        devices = chain;
+        registers.assign(devices.size(), std::vector<bool>());
+        instructions.assign(devices.size(), 0);
+        state = TestLogicReset;
+        test_logic_reset();
+        memory.clear();
+        ctrl = 0;
+        select = 0;
+        csw = 0;
+        tar = 0;
+        rdbuff = 0;
+        capture_waited = false;
+        wait_every = 0;
+        wait_length = 0;
+        wait_left = 0;
+        ap_accesses = 0;
+        stuck_wait = false;
+        fault_begin = 0;
+        fault_end = 0;
+        tck = 0;
+        wait_responses = 0;
+        tar_writes = 0;
+        drw_reads = 0;
+        drw_writes = 0;
+    }
+
+    // TDO sampled before the rising edge, then TAP moves on
+    bool step(bool tms, bool tdi)
+    {
+        tck++;
+        bool tdo = tdi;
+        if (state == ShiftDr || state == ShiftIr)
+            tdo = shift(tdi);
+        state = next_state(state, tms);
+        if (state == TestLogicReset)
+            test_logic_reset();
+        else if (state == CaptureDr)
+            capture_dr();
+        else if (state == CaptureIr)
+            capture_ir();
+        else if (state == UpdateDr)
+            update_dr();
+        else if (state == UpdateIr)
+            update_ir();
+        return tdo;
+    }
+
+    std::vector<ModelDevice> devices;
+    State state;
+
+    // DAP / MEM-AP registers
+    std::map<uint32_t, uint32_t> memory;
+    uint32_t ctrl;
+    uint32_t select;
+    uint32_t csw;
+    uint32_t tar;
+
+    // Every wait_every-th AP access answers the following wait_length scans with WAIT
+    uint32_t wait_every;
+    uint32_t wait_length;
+    bool stuck_wait;
+    // AP accesses in [fault_begin, fault_end) set STICKYERR
+    uint32_t fault_begin;
+    uint32_t fault_end;
+
+    // Counters
+    uint64_t tck;
+    uint32_t wait_responses;
+    uint32_t tar_writes;
+    uint32_t drw_reads;
+    uint32_t drw_writes;
+
+private:
+
+    static State next_state(State state, bool tms)
+    {
+        switch (state) {
+        case TestLogicReset: return tms ? TestLogicReset : RunTestIdle;
+        case RunTestIdle:    return tms ? SelectDr : RunTestIdle;
+        case SelectDr:       return tms ? SelectIr : CaptureDr;
+        case CaptureDr:      return tms ? Exit1Dr : ShiftDr;
+        case ShiftDr:        return tms ? Exit1Dr : ShiftDr;
+        case Exit1Dr:        return tms ? UpdateDr : PauseDr;
+        case PauseDr:        return tms ? Exit2Dr : PauseDr;
+        case Exit2Dr:        return tms ? UpdateDr : ShiftDr;
+        case UpdateDr:       return tms ? SelectDr : RunTestIdle;
+        case SelectIr:       return tms ? TestLogicReset : CaptureIr;
+        case CaptureIr:      return tms ? Exit1Ir : ShiftIr;
+        case ShiftIr:        return tms ? Exit1Ir : ShiftIr;
+        case Exit1Ir:        return tms ? UpdateIr : PauseIr;
+        case PauseIr:        return tms ? Exit2Ir : PauseIr;
+        case Exit2Ir:        return tms ? UpdateIr : ShiftIr;
+        case UpdateIr:       return tms ? SelectDr : RunTestIdle;
+        }
+        return TestLogicReset;
+    }
+
+    // TDI enters the last device, TDO leaves device 0, LSB first
+    bool shift(bool tdi)
+    {
+        bool carry = tdi;
+        for (size_t index = devices.size(); index-- > 0;) {
+            std::vector<bool> &bits = registers[index];
+            bool out = bits.front();
+            bits.erase(bits.begin());
+            bits.push_back(carry);
+            carry = out;
+        }
+        return carry;
+    }
+
+    static void load(std::vector<bool> &bits, uint64_t value, uint8_t length)
+    {
+        bits.clear();
+        for (uint8_t bit = 0; bit < length; bit++)
+            bits.push_back((value >> bit) & 1);
+    }
+
+    static uint64_t value_of(const std::vector<bool> &bits)
+    {
+        uint64_t value = 0;
+        for (size_t bit = 0; bit < bits.size(); bit++)
+            if (bits[bit])
+                value |= (uint64_t)1 << bit;
+        return value;
+    }
+
+    bool dap_selected(size_t index) const
+    {
+        return devices[index].dap && (instructions[index] == IR_DPACC || instructions[index] == IR_APACC);
+    }
+
+    void test_logic_reset()
+    {
+        for (size_t index = 0; index < devices.size(); index++) {
+            const ModelDevice &device = devices[index];
+            instructions[index] = device.idcode ? device.idcode_ir : (1UL << device.ir_length) - 1;
+        }
+    }
+
+    void capture_ir()
+    {
+        for (size_t index = 0; index < devices.size(); index++)
+            load(registers[index], devices[index].ir_capture, devices[index].ir_length);
+    }
+
+    void update_ir()
+    {
+        for (size_t index = 0; index < devices.size(); index++)
+            instructions[index] = value_of(registers[index]);
+    }
+
+    void capture_dr()
+    {
+        for (size_t index = 0; index < devices.size(); index++) {
+            const ModelDevice &device = devices[index];
+            if (dap_selected(index))
+                load(registers[index], dap_capture(), 35);
+            else if (device.idcode && instructions[index] == device.idcode_ir)
+                load(registers[index], device.idcode, 32);
+            else
+                load(registers[index], 0, 1);
+        }
+    }
+
+    void update_dr()
+    {
+        for (size_t index = 0; index < devices.size(); index++)
+            if (dap_selected(index))
+                dap_update(instructions[index], value_of(registers[index]));
+    }
+
+    // ACK in the low 3 bits, previous read result above
+    uint64_t dap_capture()
+    {
+        capture_waited = stuck_wait || wait_left > 0;
+        if (!capture_waited)
+            return ((uint64_t)rdbuff << 3) | ACK_OK;
+        if (wait_left > 0)
+            wait_left--;
+        wait_responses++;
+        return ACK_WAIT;
+    }
+
+    // WAIT => request ignored, must be repeated
+    void dap_update(uint32_t instruction, uint64_t request)
+    {
+        if (capture_waited)
+            return;
+        bool read = request & 1;
+        uint8_t reg = (request >> 1) & 0x3;
+        uint32_t value = request >> 3;
+        if (instruction == IR_DPACC)
+            dp_access(reg, read, value);
+        else
+            ap_access(reg, read, value);
+    }
+
+    void dp_access(uint8_t reg, bool read, uint32_t value)
+    {
+        if (reg == 1) {
+            if (read)
+                rdbuff = ctrl | ((ctrl & CTRL_POWER_REQ) << 1);
+            else
+                ctrl = (value & ~CTRL_STICKY) | (ctrl & CTRL_STICKY & ~value);
+        } else if (reg == 2 && !read) {
+            select = value;
+        }
+        // RDBUFF read leaves the last result in place
+    }
+
+    void ap_access(uint8_t reg, bool read, uint32_t value)
+    {
+        // Sticky flags block AP transactions until cleared
+        if (ctrl & CTRL_STICKYERR)
+            return;
+        ap_accesses++;
+        if (reg == 0) {
+            if (read)
+                rdbuff = csw;
+            else
+                csw = value;
+        } else if (reg == 1) {
+            if (read) {
+                rdbuff = tar;
+            } else {
+                tar = value;
+                tar_writes++;
+            }
+        } else if (reg == 3) {
+            if (tar >= fault_begin && tar < fault_end) {
+                ctrl |= CTRL_STICKYERR;
+                rdbuff = 0;
+            } else if (read) {
+                rdbuff = memory[tar];
+                drw_reads++;
+            } else {
+                memory[tar] = value;
+                drw_writes++;
+            }
+            if (((csw >> 4) & 0x3) == 1)
+                tar = (tar & ~0x3FFUL) | ((tar + 4) & 0x3FF);
+        }
+        if (wait_every && ap_accesses % wait_every == 0)
+            wait_left = wait_length;
+    }
+
+    std::vector<std::vector<bool> > registers;
+    std::vector<uint32_t> instructions;
+    uint32_t rdbuff;
+    bool capture_waited;
+    uint32_t wait_left;
+    uint32_t ap_accesses;
+};
+
+struct ModelPort
+{
+    static bool step(bool tms, bool tdi)
+    {
+        return JtagModel::instance().step(tms, tdi);
+    }
+
+    static void tck_low()
+    {
+    }
+};
+
+#endif
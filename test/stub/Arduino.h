@@ -0,0 +1,283 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// Host build stand-in for the ESP8266 Arduino core, only what server/ uses
+//  - GPOS / GPOC / GPI drive an attached JTAG model on TCK rising edges
+//  - Serial is a simulated UART, see HostUart
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#define PROGMEM
+#define PSTR(text) (text)
+
+#define INPUT        0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT       0x01
+#define FUNCTION_0   0x08
+#define FUNCTION_3   0x28
+#define LOW  0
+#define HIGH 1
+
+// Virtual time, delay() does not sleep
+struct HostClock
+{
+    static uint32_t &skipped()
+    {
+        static uint32_t ms = 0;
+        return ms;
+    }
+
+    static std::chrono::steady_clock::time_point started()
+    {
+        static std::chrono::steady_clock::time_point at = std::chrono::steady_clock::now();
+        return at;
+    }
+};
+
+inline unsigned long millis()
+{
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - HostClock::started();
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() + HostClock::skipped();
+}
+
+inline void delay(unsigned long ms)
+{
+    HostClock::skipped() += ms;
+}
+
+inline void pinMode(uint8_t, uint8_t)
+{
+}
+
+// =============================================================================================
+// GPIO registers, JTAG pins and step function attached by the test
+
+struct HostGpio
+{
+    typedef bool (*StepFunction)(bool tms, bool tdi);
+
+    uint32_t output = 0;
+    uint32_t input = 0;
+    uint32_t tck_mask = 0;
+    uint32_t tdo_mask = 0;
+    uint32_t tdi_mask = 0;
+    uint32_t tms_mask = 0;
+    StepFunction step = nullptr;
+    uint32_t gpio16_output = 0;
+    uint32_t gpio16_input = 0;
+    uint64_t writes = 0;
+    uint64_t reads = 0;
+
+    static HostGpio &instance()
+    {
+        static HostGpio gpio;
+        return gpio;
+    }
+
+    void attach_jtag(uint8_t tck, uint8_t tdo, uint8_t tdi, uint8_t tms, StepFunction function)
+    {
+        tck_mask = 1UL << tck;
+        tdo_mask = 1UL << tdo;
+        tdi_mask = 1UL << tdi;
+        tms_mask = 1UL << tms;
+        step = function;
+    }
+
+    void set(uint32_t mask)
+    {
+        writes++;
+        bool rising = (mask & tck_mask) && !(output & tck_mask);
+        output |= mask;
+        if (rising && step) {
+            bool tdo = step((output & tms_mask) != 0, (output & tdi_mask) != 0);
+            input = tdo ? (input | tdo_mask) : (input & ~tdo_mask);
+        }
+    }
+
+    void clear(uint32_t mask)
+    {
+        writes++;
+        output &= ~mask;
+    }
+};
+
+struct HostGpioSet
+{
+    void operator=(uint32_t mask)
+    {
+        HostGpio::instance().set(mask);
+    }
+};
+
+struct HostGpioClear
+{
+    void operator=(uint32_t mask)
+    {
+        HostGpio::instance().clear(mask);
+    }
+};
+
+struct HostGpioInput
+{
+    operator uint32_t() const
+    {
+        HostGpio::instance().reads++;
+        return HostGpio::instance().input;
+    }
+};
+
+// Register macros in the real core too
+#define GPOS  HostGpioSet()
+#define GPOC  HostGpioClear()
+#define GPI   HostGpioInput()
+#define GP16O (HostGpio::instance().gpio16_output)
+#define GP16I (HostGpio::instance().gpio16_input)
+
+// =============================================================================================
+// UART0, bytes written are logged with the setting in use, target side feeds rx
+
+enum SerialConfig : int
+{
+    SERIAL_8N1 = 0x1c,
+};
+
+#define UART_NB_BIT_5      0B00000000
+#define UART_NB_BIT_6      0B00000100
+#define UART_NB_BIT_7      0B00001000
+#define UART_NB_BIT_8      0B00001100
+#define UART_PARITY_NONE   0B00000000
+#define UART_PARITY_EVEN   0B00000010
+#define UART_PARITY_ODD    0B00000011
+#define UART_NB_STOP_BIT_1  0B00010000
+#define UART_NB_STOP_BIT_15 0B00100000
+#define UART_NB_STOP_BIT_2  0B00110000
+
+class HostUart
+{
+public:
+
+    struct Sent
+    {
+        uint8_t data;
+        uint32_t baud;
+        uint8_t config;
+    };
+
+    void begin(unsigned long value, SerialConfig value_config = SERIAL_8N1)
+    {
+        baud = value;
+        config = value_config;
+        open = true;
+    }
+
+    void end()
+    {
+        open = false;
+    }
+
+    size_t setRxBufferSize(size_t size)
+    {
+        rx_buffer_size = size;
+        return size;
+    }
+
+    void updateBaudRate(unsigned long value)
+    {
+        baud = value;
+    }
+
+    int available()
+    {
+        return rx.size();
+    }
+
+    int read()
+    {
+        if (rx.empty())
+            return -1;
+        uint8_t data = rx.front();
+        rx.pop_front();
+        return data;
+    }
+
+    size_t write(const uint8_t *data, size_t length)
+    {
+        write_calls++;
+        if (!open)
+            return 0;
+        for (size_t index = 0; index < length; index++) {
+            if (log_sent)
+                sent.push_back({data[index], (uint32_t)baud, (uint8_t)config});
+            if (echo)
+                rx.push_back(data[index]);
+        }
+        bytes_written += length;
+        return length;
+    }
+
+    void flush()
+    {
+    }
+
+    bool hasOverrun()
+    {
+        return false;
+    }
+
+    bool hasRxError()
+    {
+        return false;
+    }
+
+    void print(const char *) {}
+    void print(unsigned long) {}
+    void println(const char *) {}
+    void println(unsigned long) {}
+
+    // Target side
+    bool echo = false;
+    bool log_sent = false;
+    std::vector<Sent> sent;
+    std::deque<uint8_t> rx;
+    unsigned long baud = 0;
+    SerialConfig config = SERIAL_8N1;
+    size_t rx_buffer_size = 0;
+    bool open = false;
+    uint64_t write_calls = 0;
+    uint64_t bytes_written = 0;
+};
+
+static HostUart Serial;
+
+// =============================================================================================
+
+struct HostEsp
+{
+    void reset()
+    {
+        fprintf(stderr, "ESP.reset() called\n");
+        exit(2);
+    }
+
+    void restart()
+    {
+        reset();
+    }
+};
+
+#define ESP HostEsp()
+
+#define NONE_SLEEP_T 0
+
+inline void wifi_set_sleep_type(int)
+{
+}
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef ESP8266WIFI_H
+#define ESP8266WIFI_H
+
+// Host build stand-in for the ESP8266 WiFi library over loopback sockets
+//  - Servers listen on 127.0.0.1, port + host_port_offset() so the bench does not need free low ports
+//  - Accepted clients are blocking for writes, reads never block, same as the lwIP client
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <memory>
+
+// HOST_PORT_OFFSET overrides
+inline uint16_t host_port_offset()
+{
+    static uint16_t offset = getenv("HOST_PORT_OFFSET") ? atoi(getenv("HOST_PORT_OFFSET")) : 20000;
+    return offset;
+}
+
+inline void host_set_nonblocking(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+class IPAddress
+{
+public:
+    IPAddress(uint8_t first = 0, uint8_t second = 0, uint8_t third = 0, uint8_t fourth = 0) : bytes{first, second, third, fourth}
+    {
+    }
+
+    // Network byte order, as in sockaddr_in
+    static IPAddress from_network(uint32_t address)
+    {
+        IPAddress ip;
+        memcpy(ip.bytes, &address, 4);
+        return ip;
+    }
+
+    uint32_t to_network() const
+    {
+        uint32_t address;
+        memcpy(&address, bytes, 4);
+        return address;
+    }
+
+    uint8_t operator[](int index) const
+    {
+        return bytes[index];
+    }
+
+    bool operator==(const IPAddress &other) const
+    {
+        return memcmp(bytes, other.bytes, 4) == 0;
+    }
+
+private:
+    uint8_t bytes[4];
+};
+
+// =============================================================================================
+
+class WiFiClient
+{
+public:
+    WiFiClient()
+    {
+    }
+
+    explicit WiFiClient(int fd) : socket(new Socket(fd))
+    {
+    }
+
+    // Peer closed and nothing left to read => false
+    uint8_t connected()
+    {
+        if (!socket || socket->fd < 0)
+            return 0;
+        uint8_t data;
+        ssize_t length = recv(socket->fd, &data, 1, MSG_PEEK | MSG_DONTWAIT);
+        return length > 0 || (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK));
+    }
+
+    int available()
+    {
+        int length = 0;
+        if (!socket || socket->fd < 0 || ioctl(socket->fd, FIONREAD, &length) < 0)
+            return 0;
+        return length;
+    }
+
+    int read()
+    {
+        uint8_t data;
+        return read(&data, 1) == 1 ? data : -1;
+    }
+
+    size_t read(uint8_t *data, size_t length)
+    {
+        if (!socket || socket->fd < 0)
+            return 0;
+        ssize_t received = recv(socket->fd, data, length, MSG_DONTWAIT);
+        return received > 0 ? received : 0;
+    }
+
+    size_t write(uint8_t data)
+    {
+        return write(&data, 1);
+    }
+
+    size_t write(const uint8_t *data, size_t length)
+    {
+        if (!socket || socket->fd < 0)
+            return 0;
+        size_t sent = 0;
+        while (sent < length) {
+            ssize_t written = send(socket->fd, data + sent, length - sent, MSG_NOSIGNAL);
+            if (written <= 0)
+                break;
+            sent += written;
+        }
+        return sent;
+    }
+
+    size_t printf(const char *format, ...)
+    {
+        char text[128];
+        va_list arguments;
+        va_start(arguments, format);
+        int length = vsnprintf(text, sizeof(text), format, arguments);
+        va_end(arguments);
+        if (length < 0)
+            return 0;
+        return write((const uint8_t *)text, (size_t)length < sizeof(text) ? length : sizeof(text) - 1);
+    }
+
+    void flush()
+    {
+    }
+
+    // Shared with every copy, same as the lwIP context
+    void stop()
+    {
+        if (socket)
+            socket->close();
+    }
+
+    void setNoDelay(bool value)
+    {
+        if (socket && socket->fd >= 0) {
+            int flag = value;
+            setsockopt(socket->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        }
+    }
+
+    operator bool()
+    {
+        return connected();
+    }
+
+private:
+    struct Socket
+    {
+        explicit Socket(int value) : fd(value)
+        {
+        }
+
+        ~Socket()
+        {
+            close();
+        }
+
+        void close()
+        {
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+        }
+
+        int fd;
+    };
+
+    std::shared_ptr<Socket> socket;
+};
+
+// =============================================================================================
+
+class WiFiServer
+{
+public:
+    WiFiServer(uint16_t value) : port(value)
+    {
+    }
+
+    ~WiFiServer()
+    {
+        stop();
+    }
+
+    void begin()
+    {
+        if (fd >= 0)
+            return;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int flag = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port + host_port_offset());
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0 || listen(fd, 4) < 0) {
+            perror("WiFiServer::begin");
+            exit(2);
+        }
+        host_set_nonblocking(fd);
+    }
+
+    void stop()
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+
+    bool hasClient()
+    {
+        pollfd pending = {fd, POLLIN, 0};
+        return fd >= 0 && poll(&pending, 1, 0) > 0;
+    }
+
+    // Empty client when none is waiting
+    WiFiClient available()
+    {
+        int accepted = fd >= 0 ? accept(fd, nullptr, nullptr) : -1;
+        if (accepted < 0)
+            return WiFiClient();
+        WiFiClient client(accepted);
+        client.setNoDelay(no_delay);
+        return client;
+    }
+
+    void setNoDelay(bool value)
+    {
+        no_delay = value;
+    }
+
+private:
+    uint16_t port;
+    int fd = -1;
+    bool no_delay = false;
+};
+
+// =============================================================================================
+
+struct HostWiFi
+{
+    IPAddress local_ip = IPAddress(127, 0, 0, 1);
+
+    IPAddress localIP()
+    {
+        return local_ip;
+    }
+
+    void setAutoReconnect(bool)
+    {
+    }
+
+    void persistent(bool)
+    {
+    }
+
+    static HostWiFi &instance()
+    {
+        static HostWiFi wifi;
+        return wifi;
+    }
+};
+
+#define WiFi (HostWiFi::instance())
+
+#endif
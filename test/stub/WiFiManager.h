@@ -0,0 +1,31 @@
+#ifndef WIFIMANAGER_H
+#define WIFIMANAGER_H
+
+// Host build stand-in, already connected
+
+class WiFiManager
+{
+public:
+    void setConfigPortalBlocking(bool)
+    {
+    }
+
+    void setTimeout(unsigned long)
+    {
+    }
+
+    void setHostname(const char *)
+    {
+    }
+
+    bool autoConnect(const char *)
+    {
+        return true;
+    }
+
+    void resetSettings()
+    {
+    }
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef WIFIUDP_H
+#define WIFIUDP_H
+
+// Host build stand-in for WiFiUDP, bound to every local address so a datagram sent to
+// 127.0.0.2 arrives with a destination that is not WiFi.localIP()
+
+#include <ESP8266WiFi.h>
+
+class WiFiUDP
+{
+public:
+    ~WiFiUDP()
+    {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    uint8_t begin(uint16_t port)
+    {
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        int flag = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+        setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &flag, sizeof(flag));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port + host_port_offset());
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        if (bind(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+            perror("WiFiUDP::begin");
+            exit(2);
+        }
+        host_set_nonblocking(fd);
+        return 1;
+    }
+
+    // Next datagram, an unread rest of the previous one is dropped
+    int parsePacket()
+    {
+        sockaddr_in remote = {};
+        iovec data = {received, sizeof(received)};
+        uint8_t control[CMSG_SPACE(sizeof(in_pktinfo))];
+        msghdr message = {};
+        message.msg_name = &remote;
+        message.msg_namelen = sizeof(remote);
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        ssize_t length = fd >= 0 ? recvmsg(fd, &message, MSG_DONTWAIT) : -1;
+        received_length = length > 0 ? length : 0;
+        read_position = 0;
+        if (length <= 0)
+            return 0;
+        remote_ip = IPAddress::from_network(remote.sin_addr.s_addr);
+        remote_port = ntohs(remote.sin_port);
+        for (cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header))
+            if (header->cmsg_level == IPPROTO_IP && header->cmsg_type == IP_PKTINFO)
+                destination_ip = IPAddress::from_network(((in_pktinfo *)CMSG_DATA(header))->ipi_addr.s_addr);
+        return length;
+    }
+
+    int read(uint8_t *data, size_t length)
+    {
+        if (length > received_length - read_position)
+            length = received_length - read_position;
+        memcpy(data, received + read_position, length);
+        read_position += length;
+        return length;
+    }
+
+    IPAddress remoteIP()
+    {
+        return remote_ip;
+    }
+
+    uint16_t remotePort()
+    {
+        return remote_port;
+    }
+
+    IPAddress destinationIP()
+    {
+        return destination_ip;
+    }
+
+    int beginPacket(const IPAddress &ip, uint16_t port)
+    {
+        send_ip = ip;
+        send_port = port;
+        send_length = 0;
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t length)
+    {
+        if (length > sizeof(sending) - send_length)
+            length = sizeof(sending) - send_length;
+        memcpy(sending + send_length, data, length);
+        send_length += length;
+        return length;
+    }
+
+    int endPacket()
+    {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(send_port);
+        address.sin_addr.s_addr = send_ip.to_network();
+        return sendto(fd, sending, send_length, 0, (sockaddr *)&address, sizeof(address)) == (ssize_t)send_length;
+    }
+
+private:
+    int fd = -1;
+    uint8_t received[1500];
+    size_t received_length = 0;
+    size_t read_position = 0;
+    IPAddress remote_ip;
+    uint16_t remote_port = 0;
+    IPAddress destination_ip;
+
+    uint8_t sending[1500];
+    size_t send_length = 0;
+    IPAddress send_ip;
+    uint16_t send_port = 0;
+};
+
+#endif
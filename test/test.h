@@ -0,0 +1,42 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Minimal checks, failures are counted and reported, main returns test_result()
+
+static int test_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+    do { \
+        unsigned long long actual_value = (actual); \
+        unsigned long long expected_value = (expected); \
+        if (actual_value != expected_value) { \
+            printf("%s:%d: %s == 0x%llx, expected 0x%llx\n", __FILE__, __LINE__, #actual, actual_value, expected_value); \
+            test_failures++; \
+        } \
+    } while (0)
+
+#define RUN_TEST(function) \
+    do { \
+        int failures_before = test_failures; \
+        function(); \
+        printf("%s %s\n", (test_failures == failures_before) ? "PASS" : "FAIL", #function); \
+    } while (0)
+
+static int test_result()
+{
+    if (test_failures)
+        printf("%d check(s) failed\n", test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,127 @@
+#include <vector>
+
+#include "test.h"
+#include "jtag_model.h"
+#include "chain.h"
+#include "dap.h"
+
+// JtagChain discovery against the host model, chains are listed TDO side first
+
+typedef JtagChain<ModelPort> Chain;
+
+static const ModelDevice ZYNQ_PL   = {6, 0x11, 0x03722093, 0x09, false};
+static const ModelDevice ARM_DAP   = {4, 0x01, 0x4BA00477, 0x0E, true};
+// Xilinx part with a longer IR than the table assumes
+static const ModelDevice XILINX_10 = {10, 0x051, 0x04B31093, 0x09, false};
+// Unknown manufacturers, only the capture pattern tells the length
+static const ModelDevice OTHER_5   = {5, 0x01, 0x020A10DD, 0x01, false};
+static const ModelDevice BYPASS_8  = {8, 0x01, 0, 0, false};
+
+struct DapPosition
+{
+    uint8_t ir_tdo;
+    uint8_t ir_tdi;
+    uint8_t dr_tdo;
+    uint8_t dr_tdi;
+};
+
+static bool discover(Chain &chain, const std::vector<ModelDevice> &devices)
+{
+    JtagModel::instance().reset(devices);
+    chain.discover();
+    bool lengths_match = chain.device_count() == devices.size();
+    for (uint8_t index = 0; lengths_match && index < chain.device_count(); index++)
+        lengths_match = chain.idcode(index) == devices[index].idcode && chain.ir_length(index) == devices[index].ir_length;
+    return lengths_match;
+}
+
+static bool dap_at(const Chain &chain, DapPosition expected)
+{
+    DapPosition found;
+    if (!chain.find_dap(found.ir_tdo, found.ir_tdi, found.dr_tdo, found.dr_tdi))
+        return false;
+    return found.ir_tdo == expected.ir_tdo && found.ir_tdi == expected.ir_tdi &&
+           found.dr_tdo == expected.dr_tdo && found.dr_tdi == expected.dr_tdi;
+}
+
+static void test_zynq_chain()
+{
+    Chain chain;
+    CHECK(discover(chain, {ZYNQ_PL, ARM_DAP}));
+    CHECK(chain.is_valid());
+    CHECK(chain.ir_lengths_resolved());
+    // Matches the JtagDap defaults
+    CHECK(dap_at(chain, {DAP_IR_TDO_SIDE, DAP_IR_TDI_SIDE, DAP_DR_TDO_SIDE, DAP_DR_TDI_SIDE}));
+}
+
+static void test_table_length_wrong()
+{
+    Chain chain;
+    CHECK(discover(chain, {XILINX_10, ARM_DAP}));
+    CHECK(dap_at(chain, {10, 0, 1, 0}));
+}
+
+static void test_unknown_devices()
+{
+    Chain chain;
+    CHECK(discover(chain, {ARM_DAP, OTHER_5, BYPASS_8, ZYNQ_PL}));
+    CHECK(dap_at(chain, {0, 19, 0, 3}));
+    CHECK(discover(chain, {OTHER_5, ZYNQ_PL, BYPASS_8, ARM_DAP, OTHER_5}));
+    CHECK(dap_at(chain, {19, 5, 3, 1}));
+}
+
+static void test_lengths_do_not_add_up()
+{
+    // Claims to be a JTAG-DP but has a 5 bit IR
+    ModelDevice odd_dap = ARM_DAP;
+    odd_dap.ir_length = 5;
+    Chain chain;
+    JtagModel::instance().reset({odd_dap});
+    CHECK_EQUAL(chain.discover(), 1);
+    CHECK(chain.is_valid());
+    CHECK(!chain.ir_lengths_resolved());
+    CHECK_EQUAL(chain.ir_length(0), 0);
+    DapPosition found;
+    CHECK(!chain.find_dap(found.ir_tdo, found.ir_tdi, found.dr_tdo, found.dr_tdi));
+}
+
+static void test_no_devices()
+{
+    // TDI looped back to TDO
+    Chain chain;
+    JtagModel::instance().reset({});
+    CHECK_EQUAL(chain.discover(), 0);
+    CHECK(!chain.is_valid());
+    DapPosition found;
+    CHECK(!chain.find_dap(found.ir_tdo, found.ir_tdi, found.dr_tdo, found.dr_tdi));
+}
+
+// Discovered position drives memory access on a chain that is not the default
+static void test_dap_through_discovered_chain()
+{
+    Chain chain;
+    CHECK(discover(chain, {OTHER_5, ZYNQ_PL, ARM_DAP, BYPASS_8}));
+    DapPosition found;
+    CHECK(chain.find_dap(found.ir_tdo, found.ir_tdi, found.dr_tdo, found.dr_tdi));
+    JtagModel &model = JtagModel::instance();
+    for (uint32_t index = 0; index < 64; index++)
+        model.memory[0x2000 + index * 4] = 0x1000 + index;
+    JtagDap<ModelPort> dap;
+    dap.set_chain(found.ir_tdo, found.ir_tdi, found.dr_tdo, found.dr_tdi);
+    uint8_t buffer[64 * 4];
+    CHECK_EQUAL(dap.read(0x2000, 64, buffer), JtagDap<ModelPort>::Ok);
+    CHECK_EQUAL(buffer[63 * 4] | (buffer[63 * 4 + 1] << 8), 0x1000 + 63);
+    CHECK_EQUAL(dap.write(0x3000, 64, buffer), JtagDap<ModelPort>::Ok);
+    CHECK_EQUAL(model.memory[0x3000 + 63 * 4], 0x1000 + 63);
+}
+
+int main()
+{
+    RUN_TEST(test_zynq_chain);
+    RUN_TEST(test_table_length_wrong);
+    RUN_TEST(test_unknown_devices);
+    RUN_TEST(test_lengths_do_not_add_up);
+    RUN_TEST(test_no_devices);
+    RUN_TEST(test_dap_through_discovered_chain);
+    return test_result();
+}
@@ -0,0 +1,220 @@
+#include <chrono>
+#include <vector>
+
+#include "test.h"
+#include "jtag_model.h"
+#include "dap.h"
+
+// JtagDap against the host JTAG-DP model, default Zynq-7000 chain: TDI -> DAP -> PL -> TDO
+
+typedef JtagDap<ModelPort> Dap;
+
+#define TEST_BASE  0x000FFE00UL  // 512 bytes below a 1KB boundary
+#define TEST_WORDS 1024          // crosses 4 more boundaries
+
+// Pipelined read costs one 35 bit scan per word, a read + RDBUFF pair per word would double it
+#define MAX_TCK_PER_WORD 45
+
+static JtagModel &reset_model()
+{
+    JtagModel &model = JtagModel::instance();
+    model.reset({
+        {6, 0x11, 0x03722093, 0x09, false}, // Zynq-7010 PL
+        {4, 0x01, 0x4BA00477, 0x0E, true},  // ARM DAP
+    });
+    return model;
+}
+
+static uint32_t pattern(uint32_t address)
+{
+    return address * 2654435761UL ^ 0x5A5AA5A5UL;
+}
+
+static void fill_memory(JtagModel &model, uint32_t address, uint32_t words)
+{
+    for (uint32_t index = 0; index < words; index++)
+        model.memory[address + index * 4] = pattern(address + index * 4);
+}
+
+static bool buffer_matches(const std::vector<uint8_t> &buffer, uint32_t address, uint32_t words)
+{
+    for (uint32_t index = 0; index < words; index++) {
+        const uint8_t *data = &buffer[index * 4];
+        uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+        if (value != pattern(address + index * 4))
+            return false;
+    }
+    return true;
+}
+
+// 1KB regions touched, TAR has to be written once for each
+static uint32_t tar_regions(uint32_t address, uint32_t words)
+{
+    return ((address + words * 4 - 1) >> 10) - (address >> 10) + 1;
+}
+
+static void test_read_across_tar_wrap()
+{
+    JtagModel &model = reset_model();
+    fill_memory(model, TEST_BASE, TEST_WORDS);
+    Dap dap;
+    std::vector<uint8_t> buffer(TEST_WORDS * 4);
+    CHECK_EQUAL(dap.read(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Ok);
+    CHECK(buffer_matches(buffer, TEST_BASE, TEST_WORDS));
+    CHECK_EQUAL(model.drw_reads, TEST_WORDS);
+    CHECK_EQUAL(model.tar_writes, tar_regions(TEST_BASE, TEST_WORDS));
+    CHECK_EQUAL(model.csw, 0x23000012);
+    CHECK_EQUAL(model.select, 0);
+    CHECK_EQUAL(model.ctrl & JtagModel::CTRL_POWER_REQ, JtagModel::CTRL_POWER_REQ);
+}
+
+static void test_single_word_read()
+{
+    JtagModel &model = reset_model();
+    model.memory[0x1000] = 0xDEADBEEF;
+    Dap dap;
+    uint8_t buffer[4] = {0};
+    CHECK_EQUAL(dap.read(0x1000, 1, buffer), Dap::Ok);
+    CHECK_EQUAL(buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) | ((uint32_t)buffer[3] << 24), 0xDEADBEEF);
+}
+
+static void test_write_across_tar_wrap()
+{
+    JtagModel &model = reset_model();
+    std::vector<uint8_t> buffer(TEST_WORDS * 4);
+    for (uint32_t index = 0; index < TEST_WORDS; index++) {
+        uint32_t value = pattern(TEST_BASE + index * 4);
+        for (uint8_t byte = 0; byte < 4; byte++)
+            buffer[index * 4 + byte] = value >> (byte * 8);
+    }
+    Dap dap;
+    CHECK_EQUAL(dap.write(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Ok);
+    CHECK_EQUAL(model.drw_writes, TEST_WORDS);
+    CHECK_EQUAL(model.tar_writes, tar_regions(TEST_BASE, TEST_WORDS));
+    bool matches = model.memory.size() == TEST_WORDS;
+    for (uint32_t index = 0; index < TEST_WORDS; index++)
+        matches = matches && model.memory[TEST_BASE + index * 4] == pattern(TEST_BASE + index * 4);
+    CHECK(matches);
+}
+
+static void test_wait_retry()
+{
+    JtagModel &model = reset_model();
+    fill_memory(model, TEST_BASE, TEST_WORDS);
+    model.wait_every = 3;
+    model.wait_length = 5;
+    Dap dap;
+    std::vector<uint8_t> buffer(TEST_WORDS * 4);
+    CHECK_EQUAL(dap.read(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Ok);
+    CHECK(buffer_matches(buffer, TEST_BASE, TEST_WORDS));
+    // Repeated requests after WAIT must not read twice
+    CHECK_EQUAL(model.drw_reads, TEST_WORDS);
+    CHECK(model.wait_responses > TEST_WORDS);
+
+    model.memory.clear();
+    CHECK_EQUAL(dap.write(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Ok);
+    CHECK_EQUAL(model.drw_writes, TEST_WORDS);
+    CHECK_EQUAL(model.memory[TEST_BASE + (TEST_WORDS - 1) * 4], pattern(TEST_BASE + (TEST_WORDS - 1) * 4));
+}
+
+static void test_wait_timeout()
+{
+    JtagModel &model = reset_model();
+    Dap dap;
+    uint8_t buffer[16];
+    model.stuck_wait = true;
+    CHECK_EQUAL(dap.read(0x1000, 4, buffer), Dap::Wait);
+    CHECK_EQUAL(dap.write(0x1000, 4, buffer), Dap::Wait);
+    // Recovers once the target answers again
+    model.stuck_wait = false;
+    CHECK_EQUAL(dap.read(0x1000, 4, buffer), Dap::Ok);
+}
+
+static void test_sticky_error()
+{
+    JtagModel &model = reset_model();
+    fill_memory(model, TEST_BASE, TEST_WORDS);
+    model.fault_begin = TEST_BASE + 0x100;
+    model.fault_end = TEST_BASE + 0x104;
+    Dap dap;
+    std::vector<uint8_t> buffer(TEST_WORDS * 4);
+    CHECK_EQUAL(dap.read(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Fault);
+    // Cleared by the failing transfer, no leftover for the next one
+    CHECK_EQUAL(model.ctrl & JtagModel::CTRL_STICKY, 0);
+
+    model.memory.clear();
+    CHECK_EQUAL(dap.write(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Fault);
+    // AP transactions after the error are discarded by the DAP
+    CHECK_EQUAL(model.memory.size(), 0x100 / 4);
+    CHECK_EQUAL(model.ctrl & JtagModel::CTRL_STICKY, 0);
+
+    model.fault_begin = 0;
+    model.fault_end = 0;
+    fill_memory(model, TEST_BASE, TEST_WORDS);
+    CHECK_EQUAL(dap.read(TEST_BASE, TEST_WORDS, buffer.data()), Dap::Ok);
+    CHECK(buffer_matches(buffer, TEST_BASE, TEST_WORDS));
+}
+
+static void test_unaligned()
+{
+    JtagModel &model = reset_model();
+    Dap dap;
+    uint8_t buffer[8];
+    CHECK_EQUAL(dap.read(0x1002, 2, buffer), Dap::Unaligned);
+    CHECK_EQUAL(dap.write(0x1001, 2, buffer), Dap::Unaligned);
+    CHECK_EQUAL(model.tck, 0);
+}
+
+static void test_no_dap()
+{
+    JtagModel &model = reset_model();
+    model.memory[0x1000] = 0x12345678;
+    Dap dap;
+    uint8_t buffer[4] = {0};
+    dap.set_absent();
+    CHECK_EQUAL(dap.read(0x1000, 1, buffer), Dap::NoDap);
+    CHECK_EQUAL(dap.write(0x1000, 1, buffer), Dap::NoDap);
+    CHECK_EQUAL(model.tck, 0);
+    dap.set_default_chain();
+    CHECK_EQUAL(dap.read(0x1000, 1, buffer), Dap::Ok);
+    CHECK_EQUAL(buffer[0], 0x78);
+}
+
+// TCK per word is what bounds the target, host words/sec only shows the model overhead
+static void test_throughput()
+{
+    const uint32_t words = 16384;
+    JtagModel &model = reset_model();
+    fill_memory(model, 0, words);
+    Dap dap;
+    std::vector<uint8_t> buffer(words * 4);
+
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    CHECK_EQUAL(dap.read(0, words, buffer.data()), Dap::Ok);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double read_tck = (double)model.tck / words;
+    printf("read:  %.2f TCK/word, %.0f words/s on host model\n", read_tck, words / elapsed);
+    CHECK(read_tck < MAX_TCK_PER_WORD);
+
+    model.tck = 0;
+    started = std::chrono::steady_clock::now();
+    CHECK_EQUAL(dap.write(0, words, buffer.data()), Dap::Ok);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double write_tck = (double)model.tck / words;
+    printf("write: %.2f TCK/word, %.0f words/s on host model\n", write_tck, words / elapsed);
+    CHECK(write_tck < MAX_TCK_PER_WORD);
+}
+
+int main()
+{
+    RUN_TEST(test_read_across_tar_wrap);
+    RUN_TEST(test_single_word_read);
+    RUN_TEST(test_write_across_tar_wrap);
+    RUN_TEST(test_wait_retry);
+    RUN_TEST(test_wait_timeout);
+    RUN_TEST(test_sticky_error);
+    RUN_TEST(test_unaligned);
+    RUN_TEST(test_no_dap);
+    RUN_TEST(test_throughput);
+    return test_result();
+}
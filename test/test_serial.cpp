@@ -0,0 +1,132 @@
+#include <vector>
+
+#include "test.h"
+#include "serial.h"
+
+// SerialServer against the UART stub and a loopback client, telnet detection and setting order
+
+static SerialServer serial_server(SERIAL_PORT);
+
+static const uint8_t IAC = 255;
+static const uint8_t SB = 250;
+static const uint8_t SE = 240;
+static const uint8_t WILL = 251;
+static const uint8_t COM_PORT = 44;
+
+static int connect_client()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(SERIAL_PORT + host_port_offset());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) < 0) {
+        perror("connect");
+        exit(2);
+    }
+    // Accepted before anything is sent
+    serial_server.handle();
+    Serial.sent.clear();
+    Serial.rx.clear();
+    return fd;
+}
+
+// Whole request in one segment, one handle() reads it in one batch
+static void send_and_handle(int fd, const std::vector<uint8_t> &data)
+{
+    send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    for (int pass = 0; pass < 100 && Serial.sent.size() < data.size(); pass++)
+        serial_server.handle();
+}
+
+static std::vector<uint8_t> received(int fd)
+{
+    std::vector<uint8_t> data(512);
+    ssize_t length = recv(fd, data.data(), data.size(), MSG_DONTWAIT);
+    data.resize(length > 0 ? length : 0);
+    return data;
+}
+
+static std::vector<uint8_t> sent_bytes()
+{
+    std::vector<uint8_t> data;
+    for (const HostUart::Sent &sent : Serial.sent)
+        data.push_back(sent.data);
+    return data;
+}
+
+static void test_raw_leading_iac()
+{
+    int fd = connect_client();
+    send_and_handle(fd, {IAC, 'A', IAC, 'B'});
+    CHECK(sent_bytes() == std::vector<uint8_t>({IAC, 'A', IAC, 'B'}));
+    // Still raw, target output is not escaped
+    Serial.rx = {IAC, 'C'};
+    serial_server.handle();
+    CHECK(received(fd) == std::vector<uint8_t>({IAC, 'C'}));
+    close(fd);
+}
+
+static void test_raw_double_iac()
+{
+    int fd = connect_client();
+    send_and_handle(fd, {IAC, IAC, 'A'});
+    CHECK(sent_bytes() == std::vector<uint8_t>({IAC, IAC, 'A'}));
+    close(fd);
+}
+
+static void test_telnet_unescapes()
+{
+    int fd = connect_client();
+    send_and_handle(fd, {IAC, WILL, COM_PORT, 'A', IAC, IAC, 'B'});
+    CHECK(sent_bytes() == std::vector<uint8_t>({'A', IAC, 'B'}));
+    close(fd);
+}
+
+// Payload ahead of a setting change in the same batch goes out with the old setting
+static void test_payload_before_baud()
+{
+    serial_server.set_baud(SERIAL_BAUD);
+    int fd = connect_client();
+    send_and_handle(fd, {IAC, WILL, COM_PORT, 'a', 'b',
+                         IAC, SB, COM_PORT, 1, 0x00, 0x00, 0x25, 0x80, IAC, SE,
+                         'c'});
+    CHECK_EQUAL(Serial.sent.size(), 3);
+    if (Serial.sent.size() == 3) {
+        CHECK_EQUAL(Serial.sent[0].baud, SERIAL_BAUD);
+        CHECK_EQUAL(Serial.sent[1].baud, SERIAL_BAUD);
+        CHECK_EQUAL(Serial.sent[2].data, 'c');
+        CHECK_EQUAL(Serial.sent[2].baud, 9600);
+    }
+    CHECK_EQUAL(serial_server.get_baud(), 9600);
+    close(fd);
+    serial_server.set_baud(SERIAL_BAUD);
+}
+
+static void test_payload_before_framing()
+{
+    serial_server.set_framing(SERIAL_FRAMING_8N1);
+    int fd = connect_client();
+    send_and_handle(fd, {IAC, WILL, COM_PORT, 'a',
+                         IAC, SB, COM_PORT, 2, 7, IAC, SE,
+                         'b'});
+    CHECK_EQUAL(Serial.sent.size(), 2);
+    if (Serial.sent.size() == 2) {
+        CHECK_EQUAL(Serial.sent[0].config & UART_NB_BIT_8, UART_NB_BIT_8);
+        CHECK_EQUAL(Serial.sent[1].config & UART_NB_BIT_8, UART_NB_BIT_7);
+    }
+    close(fd);
+    serial_server.set_framing(SERIAL_FRAMING_8N1);
+}
+
+int main()
+{
+    serial_server.begin();
+    Serial.log_sent = true;
+    RUN_TEST(test_raw_leading_iac);
+    RUN_TEST(test_raw_double_iac);
+    RUN_TEST(test_telnet_unescapes);
+    RUN_TEST(test_payload_before_baud);
+    RUN_TEST(test_payload_before_framing);
+    return test_result();
+}